@@ -126,6 +126,9 @@ class GpsD : Object {
 				return true;
 			});
 
+		// exchange clock offsets with other nodes
+		xat_msgs.ClockSync.start(lcm, "gpsd");
+
 		// subscribe to topics
 		lcm.subscribe("xat/command",
 			(rbuf, channel, ud) => {
@@ -0,0 +1,103 @@
+/**
+ * In-process node host.
+ *
+ * Runs mavlinkd, trakd and rotd on one main context, same sources
+ * as standalone nodes built without main(). Messages between hosted
+ * nodes pass through LocalBus by reference, LCM stays for other
+ * processes (gpsd, scripts) and, with --lcm-mirror, for observers.
+ */
+class XatHost : Object {
+	private static MainLoop loop;
+
+	// main options
+	private static string? mavlinkd_args = null;
+	private static string? trakd_args = null;
+	private static string? rotd_args = null;
+	private static bool lcm_mirror = false;
+
+	private const GLib.OptionEntry[] options = {
+		{"mavlinkd", 0, 0, OptionArg.STRING, ref mavlinkd_args, "Run mavlinkd with options", "\"ARGS\""},
+		{"trakd", 0, 0, OptionArg.STRING, ref trakd_args, "Run trakd with options", "\"ARGS\""},
+		{"rotd", 0, 0, OptionArg.STRING, ref rotd_args, "Run rotd with options", "\"ARGS\""},
+		{"lcm-mirror", 0, 0, OptionArg.NONE, ref lcm_mirror, "Also publish in-process messages to LCM", null},
+
+		{null}
+	};
+
+	static construct {
+		loop = new MainLoop();
+	}
+
+	private static void sighandler(int signum) {
+		// restore original handler
+		Posix.signal(signum, null);
+		loop.quit();
+	}
+
+	private static string[] node_argv(string name, string args) throws ShellError {
+		string[] argv;
+		Shell.parse_argv(@"xat-host-$name $args", out argv);
+		return argv;
+	}
+
+	public static int main(string[] args) {
+		new XatHost();
+
+		// from FSO fraemwork
+		Posix.signal(Posix.SIGINT, sighandler);
+		Posix.signal(Posix.SIGTERM, sighandler);
+
+		try {
+			var opt_context = new OptionContext("");
+			opt_context.set_summary("In-process node host");
+			opt_context.set_description("Runs nodes in one process, e.g. --mavlinkd \"-m udp://@\" --trakd \"-e\" --rotd \"\".");
+			opt_context.set_help_enabled(true);
+			opt_context.add_main_entries(options, null);
+			opt_context.parse(ref args);
+
+			if (mavlinkd_args == null && trakd_args == null && rotd_args == null)
+				throw new OptionError.BAD_VALUE("no nodes to run");
+		} catch (OptionError e) {
+			stderr.printf("error: %s\n", e.message);
+			stderr.printf("Run '%s --help' to see a full list of available command line options.\n", args[0]);
+			return 1;
+		}
+
+		xat_msgs.LocalBus.lcm_mirror = lcm_mirror;
+
+		// consumers first, so they subscribe before producers publish
+		try {
+			if (rotd_args != null) {
+				new RotD();
+				if (RotD.setup(node_argv("rotd", rotd_args), loop) != 0)
+					return 1;
+				message("rotd started.");
+			}
+
+			if (trakd_args != null) {
+				new TrakD();
+				if (TrakD.setup(node_argv("trakd", trakd_args), loop) != 0)
+					return 1;
+				message("trakd started.");
+			}
+
+			if (mavlinkd_args != null) {
+				new MavlinkD();
+				if (MavlinkD.setup(node_argv("mavlinkd", mavlinkd_args), loop) != 0)
+					return 1;
+				message("mavlinkd started.");
+			}
+		} catch (ShellError e) {
+			stderr.printf("error: %s\n", e.message);
+			return 1;
+		}
+
+		message("xat-host started.");
+		loop.run();
+
+		if (rotd_args != null)
+			RotD.shutdown();
+		message("xat-host quit");
+		return 0;
+	}
+}
@@ -0,0 +1,244 @@
+/**
+ * FrameScanner throughput compared with Mavlink.parse_char() loop.
+ *
+ * Synthetic telemetry stream: mix of common messages with random payload,
+ * some noise between frames, part of it starts with false STX,
+ * fed in read sized chunks.
+ * Both parsers use mavlinkd message id filter, scan+copy also
+ * copies frames to Mavlink.Message as connections do.
+ *
+ * Before timing, frames from both parsers are checked against
+ * generated ones (msgid, seq, payload). Frames lost after false STX
+ * are reported, wrong frames fail the run.
+ *
+ * Usage: xat-mavlinkd-framescan-bench [MBYTES]
+ */
+
+using MavConn;
+
+// message ids seen in ArduPilot telemetry stream, last three passed by filter
+const uint8[] STREAM_IDS = { 1, 30, 74, 62, 42, 0, 24, 33 };
+const size_t CHUNK_SIZE = 4096;
+const int ROUNDS = 5;
+
+uint16 crc_accumulate(uint8 b, uint16 crc) {
+	uint8 tmp = b ^ (uint8) (crc & 0xff);
+	tmp ^= (uint8) (tmp << 4);
+	return (crc >> 8) ^ ((uint16) tmp << 8) ^ ((uint16) tmp << 3) ^ ((uint16) tmp >> 4);
+}
+
+void put_frame(ByteArray stream, Rand rnd, uint8 seq, uint8 msgid) {
+	var len = Mavlink.MESSAGE_LENGTHS[msgid];
+	var frame = new uint8[len + Mavlink.NUM_NON_PAYLOAD_BYTES];
+
+	frame[0] = Mavlink.STX;
+	frame[1] = len;
+	frame[2] = seq;
+	frame[3] = 1;
+	frame[4] = 1;
+	frame[5] = msgid;
+	for (int i = 0; i < len; i++)
+		frame[6 + i] = (uint8) rnd.int_range(0, 256);
+
+	uint16 crc = 0xffff;
+	for (int i = 1; i < 6 + len; i++)
+		crc = crc_accumulate(frame[i], crc);
+	crc = crc_accumulate(Mavlink.MESSAGE_CRCS[msgid], crc);
+
+	frame[6 + len] = (uint8) (crc & 0xff);
+	frame[7 + len] = (uint8) (crc >> 8);
+	stream.append(frame);
+}
+
+// mavlinkd filter
+bool accept_id(uint8 msgid) {
+	return msgid == Mavlink.Common.Heartbeat.MSG_ID
+		|| msgid == Mavlink.Common.GpsRawInt.MSG_ID
+		|| msgid == Mavlink.Common.GlobalPositionInt.MSG_ID;
+}
+
+/**
+ * @param frames offsets of generated frames passing filter
+ */
+uint8[] make_stream(size_t size, out size_t[] frames) {
+	var stream = new ByteArray.sized((uint) size);
+	var rnd = new Rand.with_seed(42);
+	uint8 seq = 0;
+
+	frames = {};
+	while (stream.len < size) {
+		var msgid = STREAM_IDS[rnd.int_range(0, STREAM_IDS.length)];
+		if (accept_id(msgid))
+			frames += stream.len;
+		put_frame(stream, rnd, seq++, msgid);
+
+		// line noise now and then, half of it with false STX
+		if (rnd.int_range(0, 64) == 0) {
+			var noise = new uint8[rnd.int_range(1, 4)];
+			for (int i = 0; i < noise.length; i++)
+				noise[i] = (uint8) rnd.int_range(0, 256);
+			if (rnd.boolean())
+				noise[0] = Mavlink.STX;
+			stream.append(noise);
+		}
+	}
+
+	return stream.data;
+}
+
+/**
+ * Matches parsed frames with generated ones, in order
+ */
+class FrameChecker {
+	// frames lost in a row, more is a failure
+	private const int WINDOW = 64;
+
+	private unowned uint8[] stream;
+	private unowned size_t[] frames;
+	private int next = 0;
+
+	public uint64 matched = 0;
+	public uint64 wrong = 0;
+
+	public uint64 lost {
+		get { return frames.length - matched; }
+	}
+
+	public FrameChecker(uint8[] stream, size_t[] frames) {
+		this.stream = stream;
+		this.frames = frames;
+	}
+
+	public void check(uint8 msgid, uint8 seq, uint8 len, uint8* payload) {
+		var end = int.min(next + WINDOW, frames.length);
+
+		for (int i = next; i < end; i++) {
+			var off = frames[i];
+			if (stream[off + 5] != msgid || stream[off + 2] != seq)
+				continue;
+
+			if (stream[off + 1] == len && Memory.cmp(&stream[off + 6], payload, len) == 0) {
+				matched++;
+				next = i + 1;
+				return;
+			}
+			break;
+		}
+
+		wrong++;
+	}
+
+	public bool report(string name) {
+		stdout.printf("%-12s %s frames ok, %s lost, %s wrong\n", name,
+				matched.to_string(), lost.to_string(), wrong.to_string());
+		return wrong == 0;
+	}
+}
+
+
+uint64 run_parse_char(uint8[] stream) {
+	Mavlink.Message msg = {};
+	Mavlink.Status status = {};
+	uint64 frames = 0;
+
+	// channel 1, FrameScanner uses 0 for edge frames
+	for (size_t i = 0; i < stream.length; i++) {
+		if (Mavlink.parse_char(1, stream[i], ref msg, ref status) != 0 && accept_id(msg.msgid))
+			frames++;
+	}
+
+	return frames;
+}
+
+bool check_parse_char(uint8[] stream, FrameChecker checker) {
+	Mavlink.Message msg = {};
+	Mavlink.Status status = {};
+
+	for (size_t i = 0; i < stream.length; i++) {
+		if (Mavlink.parse_char(2, stream[i], ref msg, ref status) != 0 && accept_id(msg.msgid))
+			checker.check(msg.msgid, msg.seq, msg.len, Mavlink.payload_non_const(ref msg));
+	}
+
+	return checker.report("parse_char");
+}
+
+uint64 scan_stream(uint8[] stream, bool copy, FrameChecker? checker = null) {
+	Mavlink.Message msg = {};
+	uint64 frames = 0;
+
+	var scanner = new FrameScanner((ref f) => {
+			// as IConn.handle_frame() does for message_received
+			if (copy)
+				f.to_message(ref msg);
+			if (checker != null)
+				checker.check(f.msgid, f.seq, f.len, f.payload);
+			frames++;
+		});
+
+	scanner.set_msgid_filter({
+			Mavlink.Common.Heartbeat.MSG_ID,
+			Mavlink.Common.GpsRawInt.MSG_ID,
+			Mavlink.Common.GlobalPositionInt.MSG_ID
+		});
+
+	for (size_t off = 0; off < stream.length; off += CHUNK_SIZE)
+		scanner.scan(&stream[off], size_t.min(CHUNK_SIZE, stream.length - off));
+
+	return frames;
+}
+
+uint64 run_scanner(uint8[] stream) {
+	return scan_stream(stream, false);
+}
+
+uint64 run_scanner_copy(uint8[] stream) {
+	return scan_stream(stream, true);
+}
+
+delegate uint64 ParseFunc(uint8[] stream);
+
+double measure(string name, uint8[] stream, ParseFunc func, out uint64 frames) {
+	int64 best = int64.MAX;
+
+	frames = 0;
+	for (int i = 0; i < ROUNDS; i++) {
+		var start = get_monotonic_time();
+		frames = func(stream);
+		best = int64.min(best, get_monotonic_time() - start);
+	}
+
+	var mbps = stream.length / (double) best;
+	stdout.printf("%-12s %8.1f MB/s  %s frames  %s us\n",
+			name, mbps, frames.to_string(), best.to_string());
+	return mbps;
+}
+
+int main(string[] args) {
+	size_t mbytes = 16;
+	if (args.length > 1)
+		mbytes = (size_t) int.parse(args[1]);
+
+	size_t[] frames;
+	var stream = make_stream(mbytes * 1024 * 1024, out frames);
+	stdout.printf("stream: %d bytes, %d frames pass filter\n", stream.length, frames.length);
+
+	var pc_ok = check_parse_char(stream, new FrameChecker(stream, frames));
+	var fs_checker = new FrameChecker(stream, frames);
+	scan_stream(stream, false, fs_checker);
+	var fs_ok = fs_checker.report("scan");
+
+	stdout.printf("best of %d rounds:\n", ROUNDS);
+	uint64 pc_frames, fs_frames, fc_frames;
+	var pc_mbps = measure("parse_char", stream, run_parse_char, out pc_frames);
+	var fs_mbps = measure("scan", stream, run_scanner, out fs_frames);
+	measure("scan+copy", stream, run_scanner_copy, out fc_frames);
+
+	stdout.printf("speedup: %.1fx\n", fs_mbps / pc_mbps);
+
+	if (!pc_ok || !fs_ok || fs_frames != fc_frames) {
+		stderr.printf("parsed frames differ from generated\n");
+		return 1;
+	}
+
+	return 0;
+}
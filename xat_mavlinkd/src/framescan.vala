@@ -0,0 +1,247 @@
+/**
+ * Fast MAVLink v1 frame scanner.
+ *
+ * Whole frames are found with memchr for STX and validated
+ * by length and table driven CRC, without per byte state machine.
+ * Frames split by buffer edge go through Mavlink.parse_char().
+ *
+ * Frames not passing sysid/compid/msgid filters are skipped
+ * right after header, before CRC check.
+ */
+namespace MavConn {
+	/**
+	 * Frame view into receive buffer, valid only during callback
+	 */
+	public struct Frame {
+		public uint8 len;
+		public uint8 seq;
+		public uint8 sysid;
+		public uint8 compid;
+		public uint8 msgid;
+		public uint8* payload;
+
+		/**
+		 * Copy frame into message for decoders
+		 */
+		public void to_message(ref Mavlink.Message msg) {
+			msg.magic = Mavlink.STX;
+			msg.len = len;
+			msg.seq = seq;
+			msg.sysid = sysid;
+			msg.compid = compid;
+			msg.msgid = msgid;
+			Memory.copy(Mavlink.payload_non_const(ref msg), payload, len);
+		}
+	}
+
+	public class FrameScanner {
+		/**
+		 * Valid frame found
+		 */
+		public delegate void FrameFunc(ref Frame frame);
+
+		// frame layout: STX LEN SEQ SYS COMP MSGID payload CRC_L CRC_H
+		private const size_t HEADER_LEN = 6;
+		private const size_t NON_PAYLOAD_LEN = 8;
+
+		private static uint16 crc_table[256];
+		private static uint8 crc_extra[256];
+		private static uint8 msg_length[256];
+		private static bool tables_ready = false;
+
+		// edge frames
+		private Mavlink.Message recv_msg;
+		private Mavlink.Status recv_status;
+
+		private FrameFunc frame_func;
+
+		/**
+		 * Frames dropped by CRC or length check
+		 */
+		public uint64 drops { get; private set; default = 0; }
+
+		/**
+		 * Frames skipped by filters
+		 */
+		public uint64 filtered { get; private set; default = 0; }
+
+		//! filters, -1 - any @{
+		public int sysid_filter = -1;
+		public int compid_filter = -1;
+		//! @}
+
+		private bool msgid_filter = false;
+		private bool msgid_allowed[256];
+
+		public FrameScanner(owned FrameFunc func) {
+			frame_func = (owned) func;
+			init_tables();
+		}
+
+		private static void init_tables() {
+			if (tables_ready)
+				return;
+
+			// CRC-16/MCRF4XX (X.25) as mavlink crc_accumulate()
+			for (uint i = 0; i < 256; i++) {
+				uint16 crc = (uint16) i;
+				for (int b = 0; b < 8; b++)
+					crc = ((crc & 1) != 0)? (crc >> 1) ^ 0x8408 : crc >> 1;
+				crc_table[i] = crc;
+			}
+
+			for (int i = 0; i < 256; i++) {
+				crc_extra[i] = Mavlink.MESSAGE_CRCS[i];
+				msg_length[i] = Mavlink.MESSAGE_LENGTHS[i];
+			}
+
+			tables_ready = true;
+		}
+
+		/**
+		 * Pass only listed message ids, null - all
+		 */
+		public void set_msgid_filter(uint8[]? ids) {
+			msgid_filter = (ids != null);
+			for (int i = 0; i < 256; i++)
+				msgid_allowed[i] = false;
+
+			if (ids != null) {
+				foreach (var id in ids)
+					msgid_allowed[id] = true;
+			}
+		}
+
+		private bool accept(uint8 sysid, uint8 compid, uint8 msgid) {
+			return (!msgid_filter || msgid_allowed[msgid])
+				&& (sysid_filter < 0 || sysid_filter == sysid)
+				&& (compid_filter < 0 || compid_filter == compid);
+		}
+
+		private static uint16 crc_calculate(uint8* data, size_t len, uint8 extra) {
+			uint16 crc = 0xffff;
+
+			for (size_t i = 0; i < len; i++)
+				crc = (crc >> 8) ^ crc_table[(crc ^ data[i]) & 0xff];
+
+			return (crc >> 8) ^ crc_table[(crc ^ extra) & 0xff];
+		}
+
+		/**
+		 * Feed bytes to parse_char, used for frames split by buffer edges.
+		 */
+		private void parse_bytes(uint8* data, size_t len) {
+			for (size_t i = 0; i < len; i++) {
+				var got = Mavlink.parse_char(0, data[i], ref recv_msg, ref recv_status);
+
+				// not a running total: parse_char() sets it to this byte's error
+				drops += recv_status.packet_rx_drop_count;
+
+				if (got != 0) {
+					if (!accept(recv_msg.sysid, recv_msg.compid, recv_msg.msgid)) {
+						filtered++;
+						continue;
+					}
+
+					var f = Frame() {
+						len = recv_msg.len,
+						seq = recv_msg.seq,
+						sysid = recv_msg.sysid,
+						compid = recv_msg.compid,
+						msgid = recv_msg.msgid,
+						payload = Mavlink.payload_non_const(ref recv_msg)
+					};
+					frame_func(ref f);
+				}
+			}
+		}
+
+		/**
+		 * Drop partial frame, used when stream restarts
+		 */
+		public void reset() {
+			// parse_char() keeps its state in channel status
+			Mavlink.Status* st = Mavlink.get_channel_status(0);
+			st->parse_state = Mavlink.ParseState.IDLE;
+			recv_status.parse_state = Mavlink.ParseState.IDLE;
+		}
+
+		private bool parser_busy() {
+			return recv_status.parse_state > Mavlink.ParseState.IDLE;
+		}
+
+		/**
+		 * Scan buffer, frames handed to callback in order.
+		 */
+		public void scan(uint8* data, size_t len) {
+			size_t off = 0;
+
+			// finish frame started in previous buffer
+			while (off < len && parser_busy()) {
+				parse_bytes(data + off, 1);
+				off++;
+			}
+
+			while (off < len) {
+				uint8* stx = Memory.chr(data + off, Mavlink.STX, len - off);
+				if (stx == null)
+					return;
+
+				off = (size_t) (stx - data);
+				var remaining = len - off;
+
+				if (remaining < HEADER_LEN) {
+					parse_bytes(stx, remaining);
+					return;
+				}
+
+				var plen = stx[1];
+				var mid = stx[5];
+				var frame_len = plen + NON_PAYLOAD_LEN;
+
+				// known message with other length: false STX
+				if (msg_length[mid] != 0 && msg_length[mid] != plen) {
+					off++;
+					continue;
+				}
+
+				if (remaining < frame_len) {
+					parse_bytes(stx, remaining);
+					return;
+				}
+
+				// not interested, skip without CRC.
+				// Length byte is checked only for known ids, else it may be false STX.
+				if (!accept(stx[3], stx[4], mid)) {
+					if (msg_length[mid] == plen) {
+						filtered++;
+						off += frame_len;
+					} else {
+						off++;
+					}
+					continue;
+				}
+
+				var crc = crc_calculate(stx + 1, HEADER_LEN - 1 + plen, crc_extra[mid]);
+				var frame_crc = (uint16) stx[HEADER_LEN + plen] | ((uint16) stx[HEADER_LEN + plen + 1] << 8);
+				if (crc != frame_crc) {
+					drops++;
+					off++;
+					continue;
+				}
+
+				var f = Frame() {
+					len = plen,
+					seq = stx[2],
+					sysid = stx[3],
+					compid = stx[4],
+					msgid = mid,
+					payload = stx + HEADER_LEN
+				};
+				frame_func(ref f);
+
+				off += frame_len;
+			}
+		}
+	}
+}
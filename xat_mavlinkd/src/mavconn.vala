@@ -3,9 +3,45 @@
  * Limited to listen only because i don't need send in X-AT.
  */
 namespace MavConn {
-	public interface IConn : Object {
-		public abstract Source? source { get; }
+	/**
+	 * Receive statistics
+	 */
+	public struct Stats {
+		public uint64 rx_packets;	// datagrams or reads
+		public uint64 rx_bytes;
+		public uint64 rx_truncated;	// datagrams larger than buffer
+		public uint64 rx_messages;
+		public uint64 rx_drops;		// bad CRC or framing
+		public uint64 rx_filtered;	// skipped by id filters
+	}
 
+	public interface IConn : Object {
+		/**
+		 * Attach receive sources to main loop context
+		 */
+		public abstract void attach(MainContext? context);
+
+		public abstract Stats stats { get; }
+
+		/**
+		 * Monotonic time of last read, while messages are dispatched [us]
+		 */
+		public abstract int64 rx_time { get; }
+
+		/**
+		 * Pass only listed message ids, null - all
+		 */
+		public abstract void set_msgid_filter(uint8[]? ids);
+
+		/**
+		 * Message passed filters.
+		 *
+		 * Frame is copied into Mavlink.Message: generated decoders read
+		 * the payload from message struct, and the payload in receive buffer
+		 * is not aligned. Only filtered frames get here, so the copy of
+		 * a few dozen bytes and signal emission are small next to scanning,
+		 * see bench/framescan_bench.vala.
+		 */
 		public signal void message_received(ref Mavlink.Message msg);
 
 		public static IConn? open_url(string url) throws Error {
@@ -18,6 +54,9 @@ namespace MavConn {
 			case "tcp":
 				return new TCPClientConn.from_url(url);
 
+			case "serial":
+				return new SerialConn.from_url(url);
+
 			default:
 				return_if_reached();
 				return null;
@@ -38,14 +77,80 @@ namespace MavConn {
 				port = (int16) int.parse(split[1]);
 	}
 
+	/**
+	 * Split query part from url
+	 */
+	internal string url_strip_query(string url, out string? query) {
+		var q = url.index_of_char('?');
+		if (q < 0) {
+			query = null;
+			return url;
+		}
+
+		query = url.substring(q + 1);
+		return url.substring(0, q);
+	}
+
+	/**
+	 * Parse ?ids=sysid,compid filter, -1 if not set
+	 */
+	internal void url_parse_ids(string? query, out int sysid, out int compid) {
+		sysid = -1;
+		compid = -1;
+
+		if (query == null)
+			return;
+
+		foreach (var param in query.split("&")) {
+			if (!param.has_prefix("ids="))
+				continue;
+
+			var split = param.substring(4).split(",");
+			if (split.length > 0 && split[0] != "")
+				sysid = int.parse(split[0]);
+			if (split.length > 1 && split[1] != "")
+				compid = int.parse(split[1]);
+		}
+	}
+
+	/**
+	 * Parse ?baud=N, def_baud if not set
+	 */
+	internal uint url_parse_baud(string? query, uint def_baud) {
+		if (query == null)
+			return def_baud;
+
+		foreach (var param in query.split("&")) {
+			if (param.has_prefix("baud="))
+				return (uint) int.parse(param.substring(5));
+		}
+
+		return def_baud;
+	}
+
 	public class UDPConn : Object, IConn {
 		private Mavlink.Message recv_msg;
-		private Mavlink.Status recv_status;
+		private FrameScanner scanner;
 
 		private InetSocketAddress? sender_addr = null;
 		private Socket socket;
 		private SocketSource? source_;
-		public Source? source { get { return source_; } }
+
+		private Stats stats_;
+		public Stats stats { get { return stats_; } }
+
+		private int64 rx_time_ = 0;
+		public int64 rx_time { get { return rx_time_; } }
+
+		// batched receive, buffers reused between wakeups
+		private const int RX_BATCH = 16;
+		private const size_t RX_BUFFER_SIZE = 4096;	// larger than Ethernet MTU
+		private const int MSG_TRUNC = 0x20;		// linux/socket.h
+
+		private uint8[] rx_buffer;
+		private InputVector[] rx_vectors;
+		private InputMessage[] rx_messages;
+		private SocketAddress? rx_addresses[RX_BATCH];
 
 
 		public UDPConn(InetSocketAddress? bind_addr = null) {
@@ -56,27 +161,24 @@ namespace MavConn {
 		public UDPConn.with_sockaddr(InetSocketAddress bind_addr) throws Error {
 			message(@"UDP bind: $(bind_addr.address):$(bind_addr.port)");
 
+			scanner = new FrameScanner(handle_frame);
+
 			socket = new Socket(bind_addr.address.family, SocketType.DATAGRAM, SocketProtocol.UDP);
+			socket.blocking = false;
 			socket.bind(bind_addr, true);
 
+			rx_buffer = new uint8[RX_BATCH * RX_BUFFER_SIZE];
+			rx_vectors = new InputVector[RX_BATCH];
+			rx_messages = new InputMessage[RX_BATCH];
+			for (int i = 0; i < RX_BATCH; i++) {
+				rx_vectors[i].buffer = &rx_buffer[i * RX_BUFFER_SIZE];
+				rx_vectors[i].size = RX_BUFFER_SIZE;
+			}
+
 			source_ = socket.create_source(IOCondition.IN | IOCondition.ERR | IOCondition.HUP);
 			source_.set_callback((s, cond) => {
 					try {
-						uint8 buffer[1024];
-						SocketAddress sa;
-
-						size_t read = s.receive_from(out sa, buffer);
-						if (sender_addr != sa) {
-							sender_addr = sa as InetSocketAddress;
-							debug(@"UDP remote: $(sender_addr.address):$(sender_addr.port)");
-						}
-
-						for (size_t idx = 0; idx < read; idx++) {
-							if (Mavlink.parse_char(0, buffer[idx], ref recv_msg, ref recv_status) != 0) {
-								//debug(@"got message #$(recv_msg.msgid) len $(recv_msg.len)");
-								message_received(ref recv_msg);
-							}
-						}
+						receive_batch(s);
 					} catch (Error e) {
 						error("UDP: %s", e.message);
 						// todo handle it
@@ -86,12 +188,88 @@ namespace MavConn {
 				});
 		}
 
+		/**
+		 * Drain all pending datagrams, RX_BATCH per syscall (recvmmsg)
+		 */
+		private void receive_batch(Socket s) throws Error {
+			int n;
+
+			do {
+				for (int i = 0; i < RX_BATCH; i++) {
+					rx_addresses[i] = null;
+					rx_messages[i] = InputMessage() {
+						address = &rx_addresses[i],
+						vectors = rx_vectors[i:i + 1],
+						bytes_received = 0,
+						flags = 0,
+						control_messages = null
+					};
+				}
+
+				try {
+					n = s.receive_messages(rx_messages, 0);
+				} catch (IOError.WOULD_BLOCK e) {
+					break;
+				}
+
+				rx_time_ = get_monotonic_time();
+
+				for (int i = 0; i < n; i++) {
+					update_sender(rx_addresses[i] as InetSocketAddress);
+
+					if ((rx_messages[i].flags & MSG_TRUNC) != 0) {
+						stats_.rx_truncated++;
+						warning("UDP: datagram truncated to %" + size_t.FORMAT + " bytes (%" + uint64.FORMAT + " total)",
+								RX_BUFFER_SIZE, stats_.rx_truncated);
+					}
+
+					parse_buffer(rx_vectors[i].buffer, rx_messages[i].bytes_received);
+				}
+			} while (n == RX_BATCH);
+		}
+
+		private void update_sender(InetSocketAddress? sa) {
+			if (sa == null)
+				return;
+
+			// compare by value, address objects are new for each datagram
+			if (sender_addr == null || sender_addr.port != sa.port || !sender_addr.address.equal(sa.address)) {
+				sender_addr = sa;
+				debug(@"UDP remote: $(sender_addr.address):$(sender_addr.port)");
+			}
+		}
+
+		private void parse_buffer(uint8* buffer, size_t len) {
+			stats_.rx_packets++;
+			stats_.rx_bytes += len;
+
+			scanner.scan(buffer, len);
+			stats_.rx_drops = scanner.drops;
+			stats_.rx_filtered = scanner.filtered;
+		}
+
+		public void set_msgid_filter(uint8[]? ids) {
+			scanner.set_msgid_filter(ids);
+		}
+
+		public void attach(MainContext? context) {
+			source_.attach(context);
+		}
+
+		private void handle_frame(ref Frame frame) {
+			//debug(@"got message #$(frame.msgid) len $(frame.len)");
+			stats_.rx_messages++;
+			frame.to_message(ref recv_msg);
+			message_received(ref recv_msg);
+		}
+
 		public UDPConn.from_url(string url) throws Error {
 			var proto = GLib.Uri.parse_scheme(url);
 			assert(proto == "udp");
 
 			// parse url, skip `udp://`
-			var url_sub = url.substring(6);
+			string? query;
+			var url_sub = url_strip_query(url.substring(6), out query);
 
 			var dog = url_sub.index_of_char('@');
 			assert(dog >= 0);
@@ -101,7 +279,8 @@ namespace MavConn {
 			uint16 bind_port;
 			url_parse_host_port(bind_pair, out bind_host, out bind_port, "0.0.0.0", 14550);
 
-			// TODO parse ?ids=x,y
+			int sysid, compid;
+			url_parse_ids(query, out sysid, out compid);
 
 			debug(@"UDP bind unresolved: $bind_host:$bind_port");
 
@@ -112,17 +291,36 @@ namespace MavConn {
 
 			var bind_addr = new InetSocketAddress(first_addr, bind_port);
 			this.with_sockaddr(bind_addr);
+
+			scanner.sysid_filter = sysid;
+			scanner.compid_filter = compid;
 		}
 	}
 
 	public class TCPClientConn : Object, IConn {
 		private Mavlink.Message recv_msg;
-		private Mavlink.Status recv_status;
+		private FrameScanner scanner;
 
+		private SocketConnectable server;
 		private SocketClient client;
-		private SocketConnection conn;
-		private SocketSource? source_;
-		public Source? source { get { return source_; } }
+		private SocketConnection? conn = null;
+		private SocketSource? source_ = null;
+		private MainContext? context = null;
+		private Cancellable cancellable;
+
+		private Stats stats_;
+		public Stats stats { get { return stats_; } }
+
+		private int64 rx_time_ = 0;
+		public int64 rx_time { get { return rx_time_; } }
+
+		// reconnect delay [ms], doubled after each failure
+		private const uint RECONNECT_MIN_MS = 100;
+		private const uint RECONNECT_MAX_MS = 2000;
+		private const uint CONNECT_TIMEOUT_S = 2;
+
+		private uint reconnect_delay = RECONNECT_MIN_MS;
+		private Source? reconnect_source = null;
 
 
 		public TCPClientConn(InetSocketAddress? server_addr = null) {
@@ -130,34 +328,134 @@ namespace MavConn {
 			this.with_sockaddr(server_addr?? new InetSocketAddress(new InetAddress.loopback(SocketFamily.IPV4), 5760));
 		}
 
-		public TCPClientConn.with_sockaddr(InetSocketAddress server_addr) throws Error {
+		public TCPClientConn.with_sockaddr(InetSocketAddress server_addr) {
 			message(@"TCP server: $(server_addr.address):$(server_addr.port)");
+			this.with_connectable(server_addr);
+		}
+
+		private TCPClientConn.with_connectable(SocketConnectable server) {
+			this.server = server;
+
+			scanner = new FrameScanner(handle_frame);
+			cancellable = new Cancellable();
 
 			client = new SocketClient();
-			conn = client.connect(server_addr);
+			client.timeout = CONNECT_TIMEOUT_S;
+		}
+
+		/**
+		 * Start connecting, does not wait for server
+		 */
+		public void attach(MainContext? context) {
+			this.context = context;
+			start_connect();
+		}
+
+		private void start_connect() {
+			// async results are dispatched in thread default context
+			if (context != null)
+				context.push_thread_default();
+
+			connect_server.begin();
+
+			if (context != null)
+				context.pop_thread_default();
+		}
+
+		private async void connect_server() {
+			try {
+				// NetworkAddress is resolved here, also async
+				conn = yield client.connect_async(server, cancellable);
+			} catch (IOError.CANCELLED e) {
+				return;
+			} catch (Error e) {
+				warning("TCP: connect: %s, retry in %u ms", e.message, reconnect_delay);
+				schedule_reconnect();
+				return;
+			}
 
 			message("TCP: connected to server.");
+			reconnect_delay = RECONNECT_MIN_MS;
+			scanner.reset();
 
-			// maybe better to use async methods from SocketConnection?
+			conn.socket.blocking = false;
 			source_ = conn.socket.create_source(IOCondition.IN | IOCondition.ERR | IOCondition.HUP);
-			source_.set_callback((s, cond) => {
-					try {
-						uint8 buffer[1024];
-
-						size_t read = s.receive(buffer);
-						for (size_t idx = 0; idx < read; idx++) {
-							if (Mavlink.parse_char(0, buffer[idx], ref recv_msg, ref recv_status) != 0) {
-								debug(@"got message #$(recv_msg.msgid) len $(recv_msg.len)");
-								message_received(ref recv_msg);
-							}
-						}
-					} catch (Error e) {
-						error("TCP: %s", e.message);
-						// todo handle it
-					}
+			source_.set_callback(handle_io);
+			source_.attach(context);
+		}
 
-					return true;
+		private bool handle_io(Socket s, IOCondition cond) {
+			try {
+				uint8 buffer[1024];
+
+				var read = s.receive(buffer);
+				rx_time_ = get_monotonic_time();
+				if (read == 0) {
+					warning("TCP: server closed connection");
+					disconnect();
+					return false;
+				}
+
+				stats_.rx_packets++;
+				stats_.rx_bytes += read;
+				scanner.scan(buffer, read);
+				stats_.rx_drops = scanner.drops;
+				stats_.rx_filtered = scanner.filtered;
+			} catch (IOError.WOULD_BLOCK e) {
+				// spurious wakeup
+			} catch (Error e) {
+				warning("TCP: %s", e.message);
+				disconnect();
+				return false;
+			}
+
+			return true;
+		}
+
+		private void disconnect() {
+			if (source_ != null) {
+				source_.destroy();
+				source_ = null;
+			}
+
+			if (conn != null) {
+				try {
+					conn.close();
+				} catch (Error e) {
+					debug("TCP: close: %s", e.message);
+				}
+				conn = null;
+			}
+
+			// partial frame from old stream
+			scanner.reset();
+			schedule_reconnect();
+		}
+
+		private void schedule_reconnect() {
+			if (reconnect_source != null)
+				return;
+
+			reconnect_source = new TimeoutSource(reconnect_delay);
+			reconnect_source.set_callback(() => {
+					reconnect_source = null;
+					start_connect();
+					return false;
 				});
+			reconnect_source.attach(context);
+
+			reconnect_delay = uint.min(reconnect_delay * 2, RECONNECT_MAX_MS);
+		}
+
+		public void set_msgid_filter(uint8[]? ids) {
+			scanner.set_msgid_filter(ids);
+		}
+
+		private void handle_frame(ref Frame frame) {
+			debug(@"got message #$(frame.msgid) len $(frame.len)");
+			stats_.rx_messages++;
+			frame.to_message(ref recv_msg);
+			message_received(ref recv_msg);
 		}
 
 		public TCPClientConn.from_url(string url) throws Error {
@@ -165,7 +463,8 @@ namespace MavConn {
 			assert(proto == "tcp");
 
 			// parse url, skip `tcp://`
-			var url_sub = url.substring(6);
+			string? query;
+			var url_sub = url_strip_query(url.substring(6), out query);
 
 			var sep = url_sub.index_of_char('/');
 			var server_pair = url_sub.substring(0, sep);
@@ -173,18 +472,248 @@ namespace MavConn {
 			uint16 server_port;
 			url_parse_host_port(server_pair, out server_host, out server_port, "localhost", 5760);
 
-			// TODO parse ?ids=x,y
+			int sysid, compid;
+			url_parse_ids(query, out sysid, out compid);
 
-			debug(@"TCP server unresolved: $server_host:$server_port");
-
-			// resolve host addr
-			var resolver = Resolver.get_default();
-			var addresses = resolver.lookup_by_name(server_host, null);
-			var first_addr = addresses.nth_data(0);
+			message(@"TCP server: $server_host:$server_port");
+			this.with_connectable(new NetworkAddress(server_host, server_port));
 
-			var server_addr = new InetSocketAddress(first_addr, server_port);
-			this.with_sockaddr(server_addr);
+			scanner.sysid_filter = sysid;
+			scanner.compid_filter = compid;
 		}
 	}
 
+	/**
+	 * Direct serial link, e.g. telemetry radio on USB UART.
+	 * URL: serial:///dev/ttyUSB0:57600 or serial:///dev/serial/by-path/...?baud=57600
+	 */
+	public class SerialConn : Object, IConn {
+		private Mavlink.Message recv_msg;
+		private FrameScanner scanner;
+
+		private string device;
+		private uint baudrate;
+		private int fd = -1;
+		private IOSource? source_ = null;
+		private MainContext? context = null;
+		private Source? reopen_source = null;
+
+		private Stats stats_;
+		public Stats stats { get { return stats_; } }
+
+		private int64 rx_time_ = 0;
+		public int64 rx_time { get { return rx_time_; } }
+
+		private const uint REOPEN_MS = 1000;
+
+
+		public SerialConn.with_device(string device, uint baudrate = 57600) throws Error {
+			message(@"Serial: $device baudrate $baudrate");
+
+			this.device = device;
+			this.baudrate = baudrate;
+			scanner = new FrameScanner(handle_frame);
+
+			open_port();
+		}
+
+		private static bool baud_to_speed(uint baudrate, out Posix.speed_t speed) {
+			switch (baudrate) {
+			case 9600:	speed = Posix.B9600; break;
+			case 19200:	speed = Posix.B19200; break;
+			case 38400:	speed = Posix.B38400; break;
+			case 57600:	speed = Posix.B57600; break;
+			case 115200:	speed = Posix.B115200; break;
+			case 230400:	speed = Posix.B230400; break;
+			default:
+				speed = Posix.B0;
+				return false;
+			}
+
+			return true;
+		}
+
+		private Error port_error(string what) {
+			var err = Posix.errno;
+			close_port();
+			return new IOError.FAILED("Serial: %s: %s: %s", device, what, Posix.strerror(err));
+		}
+
+		private void open_port() throws Error {
+			Posix.speed_t speed;
+			if (!baud_to_speed(baudrate, out speed))
+				throw new IOError.INVALID_ARGUMENT("Serial: unsupported baudrate %u", baudrate);
+
+			fd = Posix.open(device, Posix.O_RDWR | Posix.O_NOCTTY | Posix.O_NONBLOCK);
+			if (fd < 0)
+				throw port_error("open");
+
+			// raw 8N1, reads return what is there (fd is non-blocking)
+			Posix.termios tios;
+			if (Posix.tcgetattr(fd, out tios) < 0)
+				throw port_error("tcgetattr");
+
+			Posix.cfmakeraw(ref tios);
+			tios.c_cflag |= Posix.CLOCAL | Posix.CREAD;
+			tios.c_cc[Posix.VMIN] = 0;
+			tios.c_cc[Posix.VTIME] = 0;
+			Posix.cfsetispeed(ref tios, speed);
+			Posix.cfsetospeed(ref tios, speed);
+
+			if (Posix.tcsetattr(fd, Posix.TCSANOW, tios) < 0)
+				throw port_error("tcsetattr");
+
+			// stale bytes from before open
+			Posix.tcflush(fd, Posix.TCIFLUSH);
+			set_low_latency();
+			scanner.reset();
+		}
+
+		/**
+		 * FTDI chips hold data up to 16 ms by default, lower it to 1 ms.
+		 * Not an error for other adapters and pty.
+		 */
+		private void set_low_latency() {
+			var real = Posix.realpath(device) ?? device;
+			var path = "/sys/class/tty/%s/device/latency_timer".printf(Path.get_basename(real));
+
+			if (!FileUtils.test(path, FileTest.EXISTS)) {
+				debug("Serial: no latency_timer, not FTDI");
+				return;
+			}
+
+			// sysfs attribute, write in place
+			var f = FileStream.open(path, "w");
+			if (f == null) {
+				warning("Serial: %s: %s", path, Posix.strerror(Posix.errno));
+				return;
+			}
+
+			f.puts("1\n");
+			message("Serial: FTDI latency timer 1 ms");
+		}
+
+		private void close_port() {
+			if (source_ != null) {
+				source_.destroy();
+				source_ = null;
+			}
+
+			if (fd >= 0) {
+				Posix.close(fd);
+				fd = -1;
+			}
+		}
+
+		public void attach(MainContext? context) {
+			this.context = context;
+			start_watch();
+		}
+
+		private void start_watch() {
+			var channel = new IOChannel.unix_new(fd);
+			source_ = channel.create_watch(IOCondition.IN | IOCondition.ERR | IOCondition.HUP);
+			source_.set_callback(handle_io);
+			source_.attach(context);
+		}
+
+		private bool handle_io(IOChannel channel, IOCondition cond) {
+			uint8 buffer[1024];
+
+			// read fd directly, bypass IOChannel buffering
+			var read = Posix.read(fd, buffer, buffer.length);
+			if (read > 0) {
+				rx_time_ = get_monotonic_time();
+				stats_.rx_packets++;
+				stats_.rx_bytes += read;
+				scanner.scan(buffer, read);
+				stats_.rx_drops = scanner.drops;
+				stats_.rx_filtered = scanner.filtered;
+				return true;
+			}
+
+			var err = Posix.errno;
+			if (read < 0 && (err == Posix.EAGAIN || err == Posix.EINTR))
+				return true;
+
+			// adapter unplugged or pty closed
+			warning("Serial: %s: %s", device, (read < 0)? Posix.strerror(err) : "closed");
+			close_port();
+			schedule_reopen();
+			return false;
+		}
+
+		private void schedule_reopen() {
+			if (reopen_source != null)
+				return;
+
+			reopen_source = new TimeoutSource(REOPEN_MS);
+			reopen_source.set_callback(() => {
+					try {
+						open_port();
+					} catch (Error e) {
+						debug("%s", e.message);
+						return true;
+					}
+
+					message("Serial: %s reopened", device);
+					reopen_source = null;
+					start_watch();
+					return false;
+				});
+			reopen_source.attach(context);
+		}
+
+		public void set_msgid_filter(uint8[]? ids) {
+			scanner.set_msgid_filter(ids);
+		}
+
+		private void handle_frame(ref Frame frame) {
+			//debug(@"got message #$(frame.msgid) len $(frame.len)");
+			stats_.rx_messages++;
+			frame.to_message(ref recv_msg);
+			message_received(ref recv_msg);
+		}
+
+		private static bool is_digits(string str) {
+			if (str == "")
+				return false;
+
+			for (int i = 0; i < str.length; i++) {
+				if (!str[i].isdigit())
+					return false;
+			}
+
+			return true;
+		}
+
+		public SerialConn.from_url(string url) throws Error {
+			var proto = GLib.Uri.parse_scheme(url);
+			assert(proto == "serial");
+
+			// parse url, skip `serial://`
+			string? query;
+			var url_sub = url_strip_query(url.substring(9), out query);
+
+			// optional baudrate after last ':', if all digits:
+			// by-path names have ':' in them (...-usb-0:2:1.0-port0)
+			var device = url_sub;
+			uint baudrate = 57600;
+			var sep = url_sub.last_index_of_char(':');
+			if (sep >= 0 && is_digits(url_sub.substring(sep + 1))) {
+				device = url_sub.substring(0, sep);
+				baudrate = (uint) int.parse(url_sub.substring(sep + 1));
+			}
+
+			baudrate = url_parse_baud(query, baudrate);
+
+			int sysid, compid;
+			url_parse_ids(query, out sysid, out compid);
+
+			this.with_device(device, baudrate);
+
+			scanner.sysid_filter = sysid;
+			scanner.compid_filter = compid;
+		}
+	}
 }
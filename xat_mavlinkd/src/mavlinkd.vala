@@ -10,42 +10,70 @@ class MavlinkD {
 
 	private static bool hb_received = false;
 
+	// MAV clocks by sysid: GPS_RAW_INT time_usec and time_boot_ms
+	private static HashTable<int, SourceClock> gps_clocks;
+	private static HashTable<int, SourceClock> boot_clocks;
+
+	// connection statistics
+	private const uint STATS_PERIOD_S = 10;
+	private static MavConn.Stats last_stats;
+
 	// socket watchers
 	private static IOChannel lcm_iochannel = null;
 
 	// main options
 	private static string? mav_url = null;
 	private static string? lcm_url = null;
+	private static bool trace = false;
 
 	private const GLib.OptionEntry[] options = {
 		{"lcm-url", 'l', 0, OptionArg.STRING, ref lcm_url, "LCM connection", "URL"},
-		{"mav-url", 'm', 0, OptionArg.STRING, ref mav_url, "Mavlink connection", "URL"},
+		{"mav-url", 'm', 0, OptionArg.STRING, ref mav_url, "Mavlink connection (udp://, tcp://, serial://)", "URL"},
+		{"trace", 0, 0, OptionArg.NONE, ref trace, "Publish latency statistics", null},
 
 		{null}
 	};
 
-	private static void handle_heartbeat(ref Mavlink.Common.Heartbeat hb) {
+	private static SourceClock get_clock(HashTable<int, SourceClock> clocks, uint8 sysid) {
+		SourceClock? clock = clocks.lookup(sysid);
+		if (clock == null) {
+			clock = new SourceClock();
+			clocks.insert(sysid, clock);
+		}
+
+		return clock;
+	}
+
+	private static void handle_heartbeat(uint8 sysid, ref Mavlink.Common.Heartbeat hb) {
 		try {
 			var lhb = new xat_msgs.heartbeat_t();
 
 			lhb.header = hb_header.next_now();
+			lhb.sysid = sysid;
 
 			if (!hb_received) {
 				hb_received = true;
 				message("Got HEARTBEAT.");
 			}
 
-			lcm.publish("xat/mav/heartbeat", lhb.encode());
+			if (xat_msgs.LocalBus.publish("xat/mav/heartbeat", lhb))
+				lcm.publish("xat/mav/heartbeat", xat_msgs.LocalBus.mirror("xat/mav/heartbeat", lhb.encode()));
 		} catch (Lcm.MessageError e) {
 			error("Message Error: %s", e.message);
 		}
 	}
 
-	private static void handle_gps_raw_int(ref Mavlink.Common.GpsRawInt gps) {
+	private static void handle_gps_raw_int(uint8 sysid, ref Mavlink.Common.GpsRawInt gps) {
 		try {
 			var fix = new xat_msgs.gps_fix_t();
 
 			fix.header = fix_header.next_now();
+			fix.sysid = sysid;
+
+			// time_usec may be UTC or boot time, clock resyncs on switch.
+			// Socket read time, own decode and publish delay not in offset.
+			if (gps.time_usec != 0)
+				fix.sample_stamp = get_clock(gps_clocks, sysid).update((int64) gps.time_usec, conn.rx_time);
 
 			if (gps.fix_type < 2)
 				fix.fix_type = xat_msgs.gps_fix_t.FIX_TYPE__NO_FIX;
@@ -72,17 +100,22 @@ class MavlinkD {
 			fix.climb_rate = float.NAN;
 			fix.satellites_used = -1;
 
-			lcm.publish("xat/mav/fix", fix.encode());
+			if (xat_msgs.LocalBus.publish("xat/mav/fix", fix))
+				lcm.publish("xat/mav/fix", xat_msgs.LocalBus.mirror("xat/mav/fix", fix.encode()));
 		} catch (Lcm.MessageError e) {
 			error("Message Error: %s", e.message);
 		}
 	}
 
-	private static void handle_global_position_int(ref Mavlink.Common.GlobalPositionInt gp) {
+	private static void handle_global_position_int(uint8 sysid, ref Mavlink.Common.GlobalPositionInt gp) {
 		try {
 			var lgp = new xat_msgs.global_position_t();
 
 			lgp.header = gp_header.next_now();
+			lgp.sysid = sysid;
+			lgp.sample_stamp = get_clock(boot_clocks, sysid).update(gp.time_boot_ms * (int64) 1000, conn.rx_time);
+			lgp.origin_stamp = conn.rx_time;
+			xat_msgs.LatencyTrace.record("mav_rx", lgp.header.stamp - lgp.origin_stamp);
 
 			// fill message
 			lgp.p.latitude = gp.lat / 1E7;
@@ -94,31 +127,44 @@ class MavlinkD {
 			lgp.velocity.z = gp.vz / 1E2f;
 			lgp.heading = (gp.hdg != uint16.MAX)? gp.hdg / 1E2f : float.NAN;
 
-			lcm.publish("xat/mav/global_position", lgp.encode());
+			if (xat_msgs.LocalBus.publish("xat/mav/global_position", lgp))
+				lcm.publish("xat/mav/global_position", xat_msgs.LocalBus.mirror("xat/mav/global_position", lgp.encode()));
 		} catch (Lcm.MessageError e) {
 			error("Message Error: %s", e.message);
 		}
 	}
 
+	private static bool log_stats() {
+		var st = conn.stats;
+
+		debug("MAV rx: %" + uint64.FORMAT + " packets, %" + uint64.FORMAT + " bytes, %" + uint64.FORMAT + " messages, %" + uint64.FORMAT + " filtered",
+				st.rx_packets, st.rx_bytes, st.rx_messages, st.rx_filtered);
+
+		if (st.rx_drops != last_stats.rx_drops || st.rx_truncated != last_stats.rx_truncated)
+			warning("MAV rx: %" + uint64.FORMAT + " dropped, %" + uint64.FORMAT + " truncated",
+					st.rx_drops, st.rx_truncated);
+
+		last_stats = st;
+		return true;
+	}
+
 	static construct {
 		loop = new MainLoop();
 		hb_header = new xat_msgs.HeaderFiller();
 		fix_header = new xat_msgs.HeaderFiller();
 		gp_header = new xat_msgs.HeaderFiller();
+		gps_clocks = new HashTable<int, SourceClock>(direct_hash, direct_equal);
+		boot_clocks = new HashTable<int, SourceClock>(direct_hash, direct_equal);
 	}
 
-	private static void sighandler(int signum) {
-		// restore original handler
-		Posix.signal(signum, null);
-		loop.quit();
-	}
-
-	public static int main(string[] args) {
-		new MavlinkD();
-
-		// from FSO fraemwork
-		Posix.signal(Posix.SIGINT, sighandler);
-		Posix.signal(Posix.SIGTERM, sighandler);
+	/**
+	 * Parse options and start node on main loop
+	 *
+	 * @param host_loop loop of xat-host, null for own loop
+	 */
+	public static int setup(string[] args, MainLoop? host_loop = null) {
+		if (host_loop != null)
+			loop = host_loop;
 
 		try {
 			var opt_context = new OptionContext("");
@@ -163,6 +209,11 @@ class MavlinkD {
 				return true;
 			});
 
+		// exchange clock offsets with other nodes
+		xat_msgs.ClockSync.start(lcm, "mavlinkd");
+		if (trace)
+			xat_msgs.LatencyTrace.start(lcm, "mavlinkd");
+
 		// subscribe to topics
 		lcm.subscribe("xat/command",
 			(rbuf, channel, ud) => {
@@ -178,8 +229,15 @@ class MavlinkD {
 				}
 			});
 
+		// drop all other messages before CRC and dispatch
+		conn.set_msgid_filter({
+				Mavlink.Common.Heartbeat.MSG_ID,
+				Mavlink.Common.GpsRawInt.MSG_ID,
+				Mavlink.Common.GlobalPositionInt.MSG_ID
+			});
+
 		// setup watch on mavlink source
-		conn.source.attach(loop.get_context());
+		conn.attach(loop.get_context());
 
 		// "subscribe" to MAV topics
 		conn.message_received.connect((msg) => {
@@ -187,19 +245,19 @@ class MavlinkD {
 				case Mavlink.Common.Heartbeat.MSG_ID:
 					Mavlink.Common.Heartbeat hb = {};
 					hb.decode(msg);
-					handle_heartbeat(ref hb);
+					handle_heartbeat(msg.sysid, ref hb);
 					break;
 
 				case Mavlink.Common.GpsRawInt.MSG_ID:
 					Mavlink.Common.GpsRawInt gps = {};
 					gps.decode(msg);
-					handle_gps_raw_int(ref gps);
+					handle_gps_raw_int(msg.sysid, ref gps);
 					break;
 
 				case Mavlink.Common.GlobalPositionInt.MSG_ID:
 					Mavlink.Common.GlobalPositionInt gp = {};
 					gp.decode(msg);
-					handle_global_position_int(ref gp);
+					handle_global_position_int(msg.sysid, ref gp);
 					break;
 
 				default:
@@ -207,9 +265,33 @@ class MavlinkD {
 				}
 			});
 
+		Timeout.add_seconds(STATS_PERIOD_S, log_stats);
+
+		return 0;
+	}
+
+#if !XAT_HOST
+	private static void sighandler(int signum) {
+		// restore original handler
+		Posix.signal(signum, null);
+		loop.quit();
+	}
+
+	public static int main(string[] args) {
+		new MavlinkD();
+
+		// from FSO fraemwork
+		Posix.signal(Posix.SIGINT, sighandler);
+		Posix.signal(Posix.SIGTERM, sighandler);
+
+		var ret = setup(args);
+		if (ret != 0)
+			return ret;
+
 		message("mavlinkd started.");
 		loop.run();
 		message("mavlinkd quit");
 		return 0;
 	}
+#endif
 }
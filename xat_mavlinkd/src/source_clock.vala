@@ -0,0 +1,73 @@
+/**
+ * MAV clock to local clock mapping.
+ *
+ * Offset (local - source) is the running minimum of receive time minus
+ * sample time over two windows: link delay only adds to it, so the
+ * minimum is the least delayed sample, and window restart follows drift.
+ * Offset jumps are treated as late packets or source clock reset (reboot).
+ */
+class SourceClock : Object {
+	/**
+	 * Minimum filter window [us]
+	 */
+	public int64 window_us = 10000000;
+
+	/**
+	 * Larger offset change is outlier or clock reset [us]
+	 */
+	public int64 jump_us = 1000000;
+
+	// consecutive jumps to accept new offset
+	private const int JUMP_COUNT = 3;
+
+	private bool valid = false;
+	private int64 offset_ = 0;
+	private int64 win_start = 0;
+	private int64 win_min = 0;
+	private int64 prev_min = 0;
+	private int jumps = 0;
+
+	/**
+	 * Current offset, local - source [us]
+	 */
+	public int64 offset { get { return offset_; } }
+
+	/**
+	 * Feed sample.
+	 *
+	 * @param src_us source stamp of sample [us]
+	 * @param rx_us  local receive time [us]
+	 * @return sample time in local clock [us], 0 if unknown
+	 */
+	public int64 update(int64 src_us, int64 rx_us) {
+		var d = rx_us - src_us;
+
+		if (valid && (d > offset_ + jump_us || d < offset_ - jump_us)) {
+			if (++jumps < JUMP_COUNT) {
+				// late packet still maps well, early one means clock jump
+				return (d > offset_)? src_us + offset_ : 0;
+			}
+
+			message("Source clock jump %" + int64.FORMAT + " us, resync", d - offset_);
+			valid = false;
+		}
+
+		jumps = 0;
+
+		if (!valid) {
+			valid = true;
+			win_start = rx_us;
+			win_min = d;
+			prev_min = d;
+		} else if (rx_us - win_start > window_us) {
+			prev_min = win_min;
+			win_min = d;
+			win_start = rx_us;
+		} else if (d < win_min) {
+			win_min = d;
+		}
+
+		offset_ = (prev_min < win_min)? prev_min : win_min;
+		return src_us + offset_;
+	}
+}
@@ -0,0 +1,25 @@
+/**
+ * Pseudo terminal for serial link tests.
+ */
+
+#include <pty.h>
+#include <stddef.h>
+
+static char slave_name[64];
+
+/**
+ * Open pty pair, slave side stays open so master does not get EIO
+ * before connection opens it.
+ *
+ * @return master fd, -1 on error
+ */
+int test_pty_open(const char **name)
+{
+	int master, slave;
+
+	if (openpty(&master, &slave, slave_name, NULL, NULL) < 0)
+		return -1;
+
+	*name = slave_name;
+	return master;
+}
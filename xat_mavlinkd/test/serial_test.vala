@@ -0,0 +1,114 @@
+/**
+ * SerialConn tests on pseudo terminal.
+ *
+ * HEARTBEAT frame written to pty master should come out
+ * of message_received, with device given by url forms.
+ */
+
+using MavConn;
+
+
+[CCode (cname = "test_pty_open")]
+extern int test_pty_open(out unowned string name);
+
+const uint TIMEOUT_MS = 2000;
+
+// HEARTBEAT, sysid 42, compid 1: GCS, autopilot invalid, status active
+const uint8[] HEARTBEAT_FRAME = {
+	0xfe, 0x09, 0x00, 0x2a, 0x01, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x06, 0x08, 0x00, 0x04, 0x03,
+	0xaf, 0xd5
+};
+
+/**
+ * Open connection by url, write frame to pty master, wait for it.
+ *
+ * Own main context for each connection: it is not closed after test,
+ * and must not see hangup when master is closed.
+ */
+void check_heartbeat(string url, int master) {
+	var context = new MainContext();
+	var loop = new MainLoop(context);
+	bool received = false;
+
+	try {
+		var conn = IConn.open_url(url);
+		conn.message_received.connect((msg) => {
+				assert_cmpuint(msg.msgid, CompareOperator.EQ, Mavlink.Common.Heartbeat.MSG_ID);
+				assert_cmpuint(msg.sysid, CompareOperator.EQ, 42);
+
+				Mavlink.Common.Heartbeat hb = {};
+				hb.decode(msg);
+				assert_cmpuint(hb.type, CompareOperator.EQ, (uint) Mavlink.Common.Type.GCS);
+
+				received = true;
+				loop.quit();
+			});
+		conn.attach(context);
+
+		// after open, it flushes stale input
+		var written = Posix.write(master, HEARTBEAT_FRAME, HEARTBEAT_FRAME.length);
+		assert_cmpint((int) written, CompareOperator.EQ, HEARTBEAT_FRAME.length);
+
+		var timeout = new TimeoutSource(TIMEOUT_MS);
+		timeout.set_callback(() => {
+				loop.quit();
+				return false;
+			});
+		timeout.attach(context);
+
+		loop.run();
+		assert_cmpuint((uint) conn.stats.rx_messages, CompareOperator.EQ, 1);
+	} catch (Error e) {
+		error("%s: %s", url, e.message);
+	}
+
+	assert(received);
+}
+
+int open_pty(out string path) {
+	unowned string name;
+
+	var master = test_pty_open(out name);
+	assert(master >= 0);
+
+	path = name;
+	return master;
+}
+
+void test_baud_suffix() {
+	string path;
+	var master = open_pty(out path);
+
+	check_heartbeat(@"serial://$path:115200", master);
+
+	Posix.close(master);
+}
+
+void test_by_path() {
+	string path;
+	var master = open_pty(out path);
+
+	try {
+		// name like in /dev/serial/by-path, with ':' in it
+		var dir = DirUtils.make_tmp("xat-serial-XXXXXX");
+		var link = Path.build_filename(dir, "pci-0000:00:14.0-usb-0:2:1.0-port0");
+		assert(FileUtils.symlink(path, link) == 0);
+
+		check_heartbeat(@"serial://$link?baud=115200", master);
+
+		FileUtils.unlink(link);
+		DirUtils.remove(dir);
+	} catch (FileError e) {
+		error("%s", e.message);
+	}
+
+	Posix.close(master);
+}
+
+int main(string[] args) {
+	Test.init(ref args);
+	Test.add_func("/mavconn/serial/baud_suffix", test_baud_suffix);
+	Test.add_func("/mavconn/serial/by_path", test_by_path);
+	return Test.run();
+}
@@ -0,0 +1,169 @@
+/**
+ * Clock offset exchange between nodes.
+ *
+ * Header stamps are monotonic time of sender machine, so stamps
+ * from another machine should be converted by to_local().
+ * Each node pings others on CHANNEL and keeps offset of each peer
+ * from reply with lowest round trip of last FILTER_SIZE replies.
+ */
+public class xat_msgs.ClockSync : Object {
+	public const string CHANNEL = "xat/clock_sync";
+
+	private const int FILTER_SIZE = 8;
+
+	private class Peer : Object {
+		public int64 offsets[FILTER_SIZE];
+		public int64 delays[FILTER_SIZE];
+		public int next = 0;
+		public int count = 0;
+
+		public int64 offset = 0;	// peer - local [us]
+		public int64 delay = 0;		// round trip of that sample [us]
+
+		public void add(int64 offset, int64 delay) {
+			offsets[next] = offset;
+			delays[next] = delay;
+			next = (next + 1) % FILTER_SIZE;
+			if (count < FILTER_SIZE)
+				count++;
+
+			// least delayed sample has least asymmetry error
+			var best = 0;
+			for (int i = 1; i < count; i++) {
+				if (delays[i] < delays[best])
+					best = i;
+			}
+
+			this.offset = offsets[best];
+			this.delay = delays[best];
+		}
+	}
+
+	private static Lcm.LcmNode? lcm = null;
+	private static string node_name;
+	private static string[] local_names = {};
+	private static HeaderFiller header;
+	private static HashTable<string, Peer> peers;
+
+	/**
+	 * Start exchange, lcm should be handled by main loop
+	 *
+	 * @param node name of this node
+	 */
+	public static void start(Lcm.LcmNode lcm_node, string node, uint period_ms = 1000) {
+		// xat-host: nodes share one clock, answer for each of them
+		local_names += node;
+		if (lcm != null)
+			return;
+
+		lcm = lcm_node;
+		node_name = node;
+		header = new HeaderFiller();
+		peers = new HashTable<string, Peer>(str_hash, str_equal);
+
+		lcm.subscribe(CHANNEL,
+			(rbuf, channel, ud) => {
+				var now = HeaderFiller.now();
+
+				try {
+					var msg = new clock_sync_t.from_rbuf(rbuf);
+
+					if (is_local_node(msg.node))
+						return;
+
+					if (msg.reply_to == "") {
+						foreach (var name in local_names)
+							reply(msg, now, name);
+					} else if (msg.reply_to == node_name) {
+						update_peer(msg, now);
+					}
+				} catch (Lcm.MessageError e) {
+					warning("Clock sync message error: %s", e.message);
+				}
+			});
+
+		Timeout.add(period_ms, () => {
+				var req = new clock_sync_t();
+				req.node = node_name;
+				req.reply_to = "";
+				req.header = header.next_now();
+				req.t0 = req.header.stamp;
+
+				publish(req);
+				return true;
+			});
+	}
+
+	private static bool is_local_node(string name) {
+		foreach (var n in local_names) {
+			if (n == name)
+				return true;
+		}
+
+		return false;
+	}
+
+	private static void publish(clock_sync_t msg) {
+		try {
+			lcm.publish(CHANNEL, msg.encode());
+		} catch (Lcm.MessageError e) {
+			warning("Clock sync message error: %s", e.message);
+		}
+	}
+
+	private static void reply(clock_sync_t req, int64 now, string name) {
+		var rep = new clock_sync_t();
+		rep.node = name;
+		rep.reply_to = req.node;
+		rep.t0 = req.t0;
+		rep.t1 = now;
+		rep.header = header.next_now();
+
+		publish(rep);
+	}
+
+	private static void update_peer(clock_sync_t rep, int64 now) {
+		var t2 = rep.header.stamp;
+		var delay = (now - rep.t0) - (t2 - rep.t1);
+		if (delay < 0)
+			return;
+
+		Peer? peer = peers.lookup(rep.node);
+		if (peer == null) {
+			peer = new Peer();
+			peers.insert(rep.node, peer);
+		}
+
+		peer.add(((rep.t1 - rep.t0) + (t2 - now)) / 2, delay);
+
+		if (peer.count == 1)
+			message("Clock sync: %s offset %" + int64.FORMAT + " us, delay %" + int64.FORMAT + " us",
+					rep.node, peer.offset, peer.delay);
+	}
+
+	/**
+	 * Get peer clock offset (peer - local) [us]
+	 */
+	public static bool get_offset(string node, out int64 offset) {
+		offset = 0;
+
+		if (peers == null)
+			return false;
+
+		unowned Peer? peer = peers.lookup(node);
+		if (peer == null)
+			return false;
+
+		offset = peer.offset;
+		return true;
+	}
+
+	/**
+	 * Convert peer stamp to local clock, unchanged if peer unknown
+	 */
+	public static int64 to_local(string node, int64 stamp) {
+		int64 offset;
+		get_offset(node, out offset);
+		return stamp - offset;
+	}
+}
@@ -7,21 +7,29 @@ public class xat_msgs.HeaderFiller : Object {
 	public xat_msgs.header_t next_now() {
 		var h = new xat_msgs.header_t();
 
+		fill_now(h);
+		return h;
+	}
+
+	/**
+	 * Fill existing header, for messages reused on each publish
+	 */
+	public void fill_now(xat_msgs.header_t h) {
 		// prevent signed int overflow
 		if (last_seq == int32.MAX)
 			last_seq = 0;
 
 		h.seq = last_seq++;
 		h.stamp = now();
-		return h;
 	}
 
 	/**
 	 * Return current timestamp in microseconds
+	 *
+	 * CLOCK_MONOTONIC (vDSO, no syscall), same as get_monotonic_time().
+	 * Does not jump with NTP, but is local to machine, see ClockSync.
 	 */
 	public static int64 now() {
-		var tv = TimeVal();
-		tv.get_current_time();
-		return tv.tv_sec * 1000000 + tv.tv_usec;
+		return get_monotonic_time();
 	}
 }
@@ -0,0 +1,176 @@
+/**
+ * Latency histogram, HDR-like log-linear buckets.
+ *
+ * Values below 2^(SUB_BITS+1) are exact, above each power of two
+ * is split into 2^SUB_BITS buckets (~3% resolution). Constant time record.
+ */
+public class xat_msgs.LatencyHistogram : Object {
+	private const int SUB_BITS = 5;
+	private const int SUB_COUNT = 1 << SUB_BITS;
+	// values clamped below 2^MAX_BITS us (~18 min)
+	private const int MAX_BITS = 30;
+	private const int BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+	private int64 counts[BUCKETS];
+
+	public int64 total { get; private set; default = 0; }
+	public int64 max { get; private set; default = 0; }
+
+	private static int bucket_index(int64 v) {
+		if (v < 2 * SUB_COUNT)
+			return (int) v;
+
+		var msb = SUB_BITS + 1;
+		while ((v >> (msb + 1)) != 0)
+			msb++;
+
+		var shift = msb - SUB_BITS;
+		return shift * SUB_COUNT + (int) (v >> shift);
+	}
+
+	// highest value in bucket
+	private static int64 bucket_value(int i) {
+		if (i < 2 * SUB_COUNT)
+			return i;
+
+		var shift = i / SUB_COUNT - 1;
+		var top = i % SUB_COUNT + SUB_COUNT;
+		return (((int64) top + 1) << shift) - 1;
+	}
+
+	public void record(int64 value) {
+		if (value < 0)
+			value = 0;
+		else if (value >= (int64) 1 << MAX_BITS)
+			value = ((int64) 1 << MAX_BITS) - 1;
+
+		counts[bucket_index(value)]++;
+		total++;
+		if (value > max)
+			max = value;
+	}
+
+	/**
+	 * Value at percentile (0..100], 0 if empty
+	 */
+	public int64 percentile(double p) {
+		if (total == 0)
+			return 0;
+
+		// rank rounded up, at least first sample
+		var rank = total * p / 100.0;
+		var target = (int64) rank;
+		if (target < rank || target < 1)
+			target++;
+
+		int64 acc = 0;
+		for (int i = 0; i < BUCKETS; i++) {
+			acc += counts[i];
+			if (acc >= target)
+				return int64.min(bucket_value(i), max);
+		}
+
+		return max;
+	}
+
+	public void reset() {
+		for (int i = 0; i < BUCKETS; i++)
+			counts[i] = 0;
+
+		total = 0;
+		max = 0;
+	}
+}
+
+/**
+ * Stage latency recorder.
+ *
+ * Nodes record latency of each trace hop, histograms of last period
+ * are published on CHANNEL. Does nothing until started.
+ * Not thread safe, record from main context only.
+ */
+public class xat_msgs.LatencyTrace : Object {
+	public const string CHANNEL = "xat/stats/latency";
+
+	private static Lcm.LcmNode? lcm = null;
+	private static string node_name;
+	private static uint period;
+	private static HeaderFiller header;
+	private static HashTable<string, LatencyHistogram>? stages = null;
+	private static string[] stage_names;
+
+	public static void start(Lcm.LcmNode lcm_node, string node, uint period_ms = 10000) {
+		// xat-host: one recorder for all nodes, stage names differ
+		if (stages != null)
+			return;
+
+		lcm = lcm_node;
+		node_name = node;
+		period = period_ms;
+		header = new HeaderFiller();
+		stages = new HashTable<string, LatencyHistogram>(str_hash, str_equal);
+		stage_names = {};
+
+		Timeout.add(period_ms, publish_stats);
+		message("Latency trace: publishing on %s every %u ms", CHANNEL, period_ms);
+	}
+
+	public static bool is_enabled() {
+		return stages != null;
+	}
+
+	/**
+	 * Record stage latency [us]
+	 */
+	public static void record(string stage, int64 latency_us) {
+		if (stages == null)
+			return;
+
+		unowned LatencyHistogram? h = stages.lookup(stage);
+		if (h == null) {
+			var nh = new LatencyHistogram();
+			h = nh;
+			stages.insert(stage, (owned) nh);
+			stage_names += stage;
+		}
+
+		h.record(latency_us);
+	}
+
+	private static bool publish_stats() {
+		var msg = new latency_stats_t();
+		var n = stage_names.length;
+
+		msg.header = header.next_now();
+		msg.node = node_name;
+		msg.period_ms = (int32) period;
+		msg.count = (int16) n;
+		msg.stage = new string[n];
+		msg.samples = new int32[n];
+		msg.p50 = new int64[n];
+		msg.p99 = new int64[n];
+		msg.max = new int64[n];
+
+		for (int i = 0; i < n; i++) {
+			var h = stages.lookup(stage_names[i]);
+
+			msg.stage[i] = stage_names[i];
+			msg.samples[i] = (int32) h.total;
+			msg.p50[i] = h.percentile(50.0);
+			msg.p99[i] = h.percentile(99.0);
+			msg.max[i] = h.max;
+
+			debug("Latency %s: n %" + int64.FORMAT + " p50 %" + int64.FORMAT + " p99 %" + int64.FORMAT + " max %" + int64.FORMAT + " us",
+					stage_names[i], h.total, msg.p50[i], msg.p99[i], msg.max[i]);
+			h.reset();
+		}
+
+		try {
+			lcm.publish(CHANNEL, msg.encode());
+		} catch (Lcm.MessageError e) {
+			warning("Latency stats message error: %s", e.message);
+		}
+
+		return true;
+	}
+}
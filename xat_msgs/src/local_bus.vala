@@ -0,0 +1,134 @@
+/**
+ * In-process message bus.
+ *
+ * Nodes hosted in one process (xat-host) pass message objects
+ * by reference, without encode, LCM socket round trip and decode.
+ * Received message is shared, handlers should not modify it.
+ * Publisher may reuse message object, so handlers copy what they keep.
+ * Standalone nodes have no local subscribers and publish to LCM as usual.
+ *
+ * With lcm_mirror the LCM copy comes back to own LCM subscribers,
+ * those drop it with is_echo(). Same channel from other processes
+ * (e.g. xat-sim) is still received.
+ */
+public class xat_msgs.LocalBus : Object {
+	public delegate void Handler(Object msg);
+
+	private class Subscriber {
+		public Handler handler;
+
+		public Subscriber(owned Handler handler) {
+			this.handler = (owned) handler;
+		}
+	}
+
+	// hashes of recently mirrored messages, echo comes back soon
+	private class MirrorLog {
+		public const int SIZE = 8;
+
+		public uint[] hashes = new uint[SIZE];
+		public int next = 0;
+		public int count = 0;
+	}
+
+	private static HashTable<string, GenericArray<Subscriber>>? channels = null;
+	private static HashTable<string, MirrorLog>? mirrored = null;
+
+	/**
+	 * Publish locally delivered messages to LCM too, for external observers
+	 */
+	public static bool lcm_mirror = false;
+
+	public static void subscribe(string channel, owned Handler handler) {
+		if (channels == null)
+			channels = new HashTable<string, GenericArray<Subscriber>>(str_hash, str_equal);
+
+		unowned GenericArray<Subscriber>? subs = channels.lookup(channel);
+		if (subs == null) {
+			var new_subs = new GenericArray<Subscriber>();
+			subs = new_subs;
+			channels.insert(channel, (owned) new_subs);
+		}
+
+		subs.add(new Subscriber((owned) handler));
+	}
+
+	/**
+	 * Deliver message to local subscribers
+	 *
+	 * @return true if message should be published to LCM
+	 */
+	public static bool publish(string channel, Object msg) {
+		if (channels == null)
+			return true;
+
+		unowned GenericArray<Subscriber>? subs = channels.lookup(channel);
+		if (subs == null)
+			return true;
+
+		for (int i = 0; i < subs.length; i++)
+			subs[i].handler(msg);
+
+		return lcm_mirror;
+	}
+
+	/**
+	 * Note LCM copy of message passed to publish()
+	 *
+	 * @return data, to pass on to LCM publish
+	 */
+	public static unowned uint8[] mirror(string channel, uint8[] data) {
+		if (!lcm_mirror || channels == null || !channels.contains(channel))
+			return data;
+
+		if (mirrored == null)
+			mirrored = new HashTable<string, MirrorLog>(str_hash, str_equal);
+
+		unowned MirrorLog? log = mirrored.lookup(channel);
+		if (log == null) {
+			var new_log = new MirrorLog();
+			log = new_log;
+			mirrored.insert(channel, (owned) new_log);
+		}
+
+		log.hashes[log.next] = data_hash(data);
+		log.next = (log.next + 1) % MirrorLog.SIZE;
+		log.count = int.min(log.count + 1, MirrorLog.SIZE);
+
+		return data;
+	}
+
+	/**
+	 * Message received from LCM is own mirrored copy, already delivered locally
+	 */
+	public static bool is_echo(string channel, uint8[] data) {
+		if (mirrored == null)
+			return false;
+
+		unowned MirrorLog? log = mirrored.lookup(channel);
+		if (log == null || log.count == 0)
+			return false;
+
+		var hash = data_hash(data);
+		for (int i = 0; i < log.count; i++) {
+			var idx = (log.next - 1 - i + MirrorLog.SIZE) % MirrorLog.SIZE;
+			if (log.hashes[idx] == hash) {
+				// each copy echoes once
+				log.hashes[idx] = ~hash;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// FNV-1a, messages differ at least in header stamp
+	private static uint data_hash(uint8[] data) {
+		uint hash = 2166136261;
+
+		foreach (var b in data)
+			hash = (hash ^ b) * 16777619;
+
+		return hash;
+	}
+}
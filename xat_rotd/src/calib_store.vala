@@ -0,0 +1,102 @@
+/**
+ * Calibration state file.
+ *
+ * Keeps homing result and last known step counts of each board
+ * (group per device name), so rotd may resume tracking after restart
+ * without homing if board was not powered off.
+ */
+class CalibStore : Object {
+	public struct Entry {
+		public bool homed;
+		// last reported position [step]
+		public int32 azimuth_position;
+		public int32 elevation_position;
+		// last sent goal [step], board may move there after rotd died
+		public int32 azimuth_goal;
+		public int32 elevation_goal;
+	}
+
+	public string path { get; private set; }
+
+	private KeyFile keyfile;
+
+	// asynchronous write state
+	private bool saving = false;
+	private bool dirty = false;
+
+	public CalibStore(string path) {
+		this.path = path;
+		keyfile = new KeyFile();
+
+		try {
+			keyfile.load_from_file(path, KeyFileFlags.NONE);
+		} catch (Error e) {
+			message("Calibration state not loaded: %s", e.message);
+		}
+	}
+
+	/**
+	 * Returns saved entry of device
+	 */
+	public bool lookup(string name, out Entry entry) {
+		entry = Entry();
+
+		try {
+			entry.homed = keyfile.get_boolean(name, "homed");
+			entry.azimuth_position = keyfile.get_integer(name, "azimuth_position");
+			entry.elevation_position = keyfile.get_integer(name, "elevation_position");
+			entry.azimuth_goal = keyfile.get_integer(name, "azimuth_goal");
+			entry.elevation_goal = keyfile.get_integer(name, "elevation_goal");
+		} catch (KeyFileError e) {
+			return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Update entry and start file write
+	 *
+	 * File is written by GIO worker thread, so fsync on slow storage
+	 * does not stall main loop. Updates made during write are saved
+	 * by next write.
+	 */
+	public void store(string name, Entry entry) {
+		keyfile.set_boolean(name, "homed", entry.homed);
+		keyfile.set_integer(name, "azimuth_position", entry.azimuth_position);
+		keyfile.set_integer(name, "elevation_position", entry.elevation_position);
+		keyfile.set_integer(name, "azimuth_goal", entry.azimuth_goal);
+		keyfile.set_integer(name, "elevation_goal", entry.elevation_goal);
+
+		dirty = true;
+		if (!saving)
+			save.begin();
+	}
+
+	/**
+	 * Wait for pending writes, for shutdown after main loop quit
+	 */
+	public void flush() {
+		var ctx = MainContext.default();
+		while (saving)
+			ctx.iteration(true);
+	}
+
+	private async void save() {
+		var file = File.new_for_path(path);
+
+		saving = true;
+		while (dirty) {
+			dirty = false;
+			var data = new Bytes(keyfile.to_data().data);
+
+			try {
+				// atomic replace, file is valid after crash
+				yield file.replace_contents_bytes_async(data, null, false, FileCreateFlags.NONE, null, null);
+			} catch (Error e) {
+				warning("Calibration state save: %s", e.message);
+			}
+		}
+		saving = false;
+	}
+}
@@ -29,6 +29,12 @@ namespace XatHid {
 			public uint8 device_caps[60];
 			//! @}
 
+			//! capability names @{
+			public const string CAP_STATUS_STREAM = "STATUS_STREAM";
+			public const string CAP_TELEMETRY = "TELEMETRY";
+			public const string CAP_ENDSTOP_LATCH = "ENDSTOP_LATCH";
+			//! @}
+
 			public string device_caps_str {
 				get {
 					this.device_caps[59] = '\0';
@@ -36,6 +42,18 @@ namespace XatHid {
 				}
 			}
 
+			/**
+			 * Check capability in caps string (comma or space separated)
+			 */
+			public bool has_cap(string cap) {
+				foreach (var tok in device_caps_str.split_set(", ;")) {
+					if (tok == cap)
+						return true;
+				}
+
+				return false;
+			}
+
 			public void decode(uint8[] report) throws ConvertError {
 				size_t off = 0;
 
@@ -103,17 +121,14 @@ namespace XatHid {
 			//! @}
 
 			public void decode(uint8[] report) throws ConvertError {
-				size_t off = 0;
-
-				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
-				if (report_id != REPORT_ID || report.length != REPORT_SIZE) {
-					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.Status");
-				}
+				StatusData data = {};
 
-				decode_uint8(report, off, out flags);		off += sizeof(uint8);
-				decode_uint8(report, off, out buttons);		off += sizeof(uint8);
-				decode_int32(report, off, out azimuth_position);off += sizeof(int32);
-				decode_int32(report, off, out elevation_position);
+				data.decode(report);
+				report_id = REPORT_ID;
+				flags = data.flags;
+				buttons = data.buttons;
+				azimuth_position = data.azimuth_position;
+				elevation_position = data.elevation_position;
 			}
 
 			public uint8[] encode() {
@@ -148,14 +163,11 @@ namespace XatHid {
 			}
 
 			public void decode(uint8[] report) throws ConvertError {
-				size_t off = 0;
-
-				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
-				if (report_id != REPORT_ID || report.length != REPORT_SIZE) {
-					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.BatVoltage");
-				}
+				BatVoltageData data = {};
 
-				decode_uint16(report, off, out raw_adc);
+				data.decode(report);
+				report_id = REPORT_ID;
+				raw_adc = data.raw_adc;
 			}
 
 			public uint8[] encode() {
@@ -238,12 +250,9 @@ namespace XatHid {
 
 			public uint8[] encode() {
 				var buf = new uint8[REPORT_SIZE];
-				size_t off = 0;
-
-				encode_uint8(buf, off, report_id);		off += sizeof(uint8);
-				encode_int32(buf, off, azimuth_position);	off += sizeof(int32);
-				encode_int32(buf, off, elevation_position);
+				AzElData data = { azimuth_position, elevation_position };
 
+				data.encode(buf);
 				return buf;
 			}
 		}
@@ -341,17 +350,318 @@ namespace XatHid {
 				// Stub. write-only
 			}
 
+			public uint8[] encode() {
+				var buf = new uint8[REPORT_SIZE];
+				StopData data = { motor };
+
+				data.encode(buf);
+				return buf;
+			}
+		}
+
+		/**
+		 * Status pushed by device on change or at stream rate. RO,I.
+		 * Same data as Status plus device timestamp.
+		 * Sent only if Info caps has STATUS_STREAM and streaming enabled.
+		 */
+		public class StatusStream : IReport {
+			public const uint8 REPORT_ID = 9;
+			public const size_t REPORT_SIZE = 1 + 2 + 8 + 4;
+
+			//! report data @{
+			public uint8 report_id = REPORT_ID;
+			public StatusData data;
+			//! @}
+
+			public void decode(uint8[] report) throws ConvertError {
+				data.decode_stream(report);
+			}
+
+			public uint8[] encode() {
+				var buf = new uint8[REPORT_SIZE];
+
+				encode_uint8(buf, 0, report_id);
+				// only report id for RO
+
+				return buf;
+			}
+		}
+
+		/**
+		 * Status stream settings. RW,F.
+		 */
+		public class StreamSettings : IReport {
+			public const uint8 REPORT_ID = 10;
+			public const size_t REPORT_SIZE = 1 + 1 + 2;
+
+			//! report data @{
+			public uint8 report_id = REPORT_ID;
+			public uint8 enable = 0;
+			public uint16 period_ms = 0;	// 0 - only on change
+			//! @}
+
+			public StreamSettings.with_data(bool enable, uint16 period_ms) {
+				this.enable = enable? 1 : 0;
+				this.period_ms = period_ms;
+			}
+
+			public void decode(uint8[] report) throws ConvertError {
+				size_t off = 0;
+
+				decode_uint8 (report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != REPORT_ID || report.length != REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.StreamSettings");
+				}
+
+				decode_uint8 (report, off, out enable);		off += sizeof(uint8);
+				decode_uint16(report, off, out period_ms);
+			}
+
 			public uint8[] encode() {
 				var buf = new uint8[REPORT_SIZE];
 				size_t off = 0;
 
-				encode_uint8(buf, off, report_id);	off += sizeof(uint8);
-				encode_uint8(buf, off, report_id);
+				encode_uint8 (buf, off, report_id);		off += sizeof(uint8);
+				encode_uint8 (buf, off, enable);		off += sizeof(uint8);
+				encode_uint16(buf, off, period_ms);
+
+				return buf;
+			}
+		}
+
+		/**
+		 * Combined status and battery voltage. RO,G.
+		 * Sent only if Info caps has TELEMETRY.
+		 *
+		 * Returns Status and BatVoltage data in one transfer.
+		 */
+		public class Telemetry : IReport {
+			public const uint8 REPORT_ID = 11;
+			public const size_t REPORT_SIZE = 1 + 2 + 8 + 2;
+
+			//! report data @{
+			public uint8 report_id = REPORT_ID;
+			public TelemetryData data;
+			//! @}
+
+			public void decode(uint8[] report) throws ConvertError {
+				data.decode(report);
+			}
+
+			public uint8[] encode() {
+				var buf = new uint8[REPORT_SIZE];
+
+				encode_uint8(buf, 0, report_id);
+				// only report id for get
+
+				return buf;
+			}
+		}
+
+		/**
+		 * Stepper positions latched by firmware on endstop rising edge. RW,F.
+		 * Sent only if Info caps has ENDSTOP_LATCH.
+		 *
+		 * Set (any data) clears latches and arms them again.
+		 */
+		public class EndstopLatch : IReport {
+			public const uint8 REPORT_ID = 12;
+			public const size_t REPORT_SIZE = 1 + 1 + 4 * 2;
+
+			[Flags]
+			public enum Flags {
+				AZ_LATCHED = (1<<0),
+				EL_LATCHED = (1<<1)
+			}
+
+			//! report data @{
+			public uint8 report_id = REPORT_ID;
+			public EndstopLatchData data;
+			//! @}
+
+			public void decode(uint8[] report) throws ConvertError {
+				data.decode(report);
+			}
+
+			public uint8[] encode() {
+				var buf = new uint8[REPORT_SIZE];
+
+				encode_uint8(buf, 0, report_id);
+				// zero data for arm request
 
 				return buf;
+			}
+		}
+
+		/**
+		 * Plain struct reports for steady state path.
+		 *
+		 * Encoded and decoded in caller provided buffers,
+		 * so no heap allocations done. Report classes above wrap them.
+		 * @{
+		 */
+		public struct StatusData {
+			public uint8 flags;
+			public uint8 buttons;
+			public int32 azimuth_position;
+			public int32 elevation_position;
+			public uint32 device_time;	// [us], only in StatusStream, 0 if polled
+			public int64 device_stamp;	// [us], device_time unwrapped by host, 0 if polled
+
+			//! flag accessors @{
+			public bool az_in_motion() {
+				return (this.flags & Status.Flags.AZ_IN_MOTION) != 0;
+			}
+
+			public bool el_in_motion() {
+				return (this.flags & Status.Flags.EL_IN_MOTION) != 0;
+			}
+
+			public bool az_endstop() {
+				return (this.buttons & Status.Buttons.AZ_ENDSTOP) != 0;
+			}
+
+			public bool el_endstop() {
+				return (this.buttons & Status.Buttons.EL_ENDSTOP) != 0;
+			}
+			//! @}
+
+			public void decode(uint8[] report) throws ConvertError {
+				size_t off = 0;
+				uint8 report_id;
+
+				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != Status.REPORT_ID || report.length != Status.REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.Status");
+				}
+
+				decode_uint8(report, off, out flags);		off += sizeof(uint8);
+				decode_uint8(report, off, out buttons);		off += sizeof(uint8);
+				decode_int32(report, off, out azimuth_position);off += sizeof(int32);
+				decode_int32(report, off, out elevation_position);
+				device_time = 0;
+				device_stamp = 0;
+			}
+
+			public void decode_stream(uint8[] report) throws ConvertError {
+				size_t off = 0;
+				uint8 report_id;
+
+				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != StatusStream.REPORT_ID || report.length != StatusStream.REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.StatusStream");
+				}
+
+				decode_uint8(report, off, out flags);		off += sizeof(uint8);
+				decode_uint8(report, off, out buttons);		off += sizeof(uint8);
+				decode_int32(report, off, out azimuth_position);off += sizeof(int32);
+				decode_int32(report, off, out elevation_position);off += sizeof(int32);
+				decode_uint32(report, off, out device_time);
+				device_stamp = 0;
+			}
+		}
+
+		public struct BatVoltageData {
+			public uint16 raw_adc;
+
+			public float battery_voltage() {
+				// only for current arduino based prototype
+				// Vref = 5 V, Input divider 1/3
+				return (this.raw_adc / 1023.0f) * 5.0f * 3.0f;
+			}
+
+			public void decode(uint8[] report) throws ConvertError {
+				size_t off = 0;
+				uint8 report_id;
+
+				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != BatVoltage.REPORT_ID || report.length != BatVoltage.REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.BatVoltage");
+				}
+
+				decode_uint16(report, off, out raw_adc);
+			}
+		}
+
+		public struct TelemetryData {
+			public StatusData status;
+			public BatVoltageData bat_voltage;
+
+			public void decode(uint8[] report) throws ConvertError {
+				size_t off = 0;
+				uint8 report_id;
+
+				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != Telemetry.REPORT_ID || report.length != Telemetry.REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.Telemetry");
+				}
+
+				decode_uint8(report, off, out status.flags);	off += sizeof(uint8);
+				decode_uint8(report, off, out status.buttons);	off += sizeof(uint8);
+				decode_int32(report, off, out status.azimuth_position);	off += sizeof(int32);
+				decode_int32(report, off, out status.elevation_position);	off += sizeof(int32);
+				decode_uint16(report, off, out bat_voltage.raw_adc);
+				status.device_time = 0;
+				status.device_stamp = 0;
+			}
+		}
 
+		public struct EndstopLatchData {
+			public uint8 flags;
+			public int32 azimuth_position;
+			public int32 elevation_position;
+
+			public bool az_latched() {
+				return (this.flags & EndstopLatch.Flags.AZ_LATCHED) != 0;
+			}
+
+			public bool el_latched() {
+				return (this.flags & EndstopLatch.Flags.EL_LATCHED) != 0;
+			}
+
+			public void decode(uint8[] report) throws ConvertError {
+				size_t off = 0;
+				uint8 report_id;
+
+				decode_uint8(report, off, out report_id);	off += sizeof(uint8);
+				if (report_id != EndstopLatch.REPORT_ID || report.length != EndstopLatch.REPORT_SIZE) {
+					throw new ConvertError.ILLEGAL_SEQUENCE("not a Report.EndstopLatch");
+				}
+
+				decode_uint8(report, off, out flags);		off += sizeof(uint8);
+				decode_int32(report, off, out azimuth_position);off += sizeof(int32);
+				decode_int32(report, off, out elevation_position);
+			}
+		}
+
+		public struct AzElData {
+			public int32 azimuth_position;
+			public int32 elevation_position;
+
+			public void encode(uint8[] buf)
+				requires(buf.length == AzEl.REPORT_SIZE)
+			{
+				size_t off = 0;
+
+				encode_uint8(buf, off, AzEl.REPORT_ID);		off += sizeof(uint8);
+				encode_int32(buf, off, azimuth_position);	off += sizeof(int32);
+				encode_int32(buf, off, elevation_position);
+			}
+		}
+
+		public struct StopData {
+			public uint8 motor;
+
+			public void encode(uint8[] buf)
+				requires(buf.length == Stop.REPORT_SIZE)
+			{
+				size_t off = 0;
+
+				encode_uint8(buf, off, Stop.REPORT_ID);	off += sizeof(uint8);
+				encode_uint8(buf, off, motor);
 			}
 		}
+		//! @}
 
 		/**
 		 * Decoder and encoder helpers
@@ -385,6 +695,12 @@ namespace XatHid {
 			val = uint16.from_little_endian(le16);
 		}
 
+		internal void decode_uint32(uint8[] buf, size_t off, out uint32 val) {
+			uint32 le32 = 0;
+			Memory.copy(&le32, &buf[off], sizeof(uint32));
+			val = uint32.from_little_endian(le32);
+		}
+
 		internal void decode_int32(uint8[] buf, size_t off, out int32 val) {
 			int32 le32 = 0;
 			Memory.copy(&le32, &buf[off], sizeof(int32));
@@ -396,32 +712,96 @@ namespace XatHid {
 	public class HIDConn {
 		private HidApi.Device handle;
 
+		// preallocated buffers for steady state path
+		private uint8[] status_buffer = new uint8[Report.Status.REPORT_SIZE];
+		private uint8[] bat_voltage_buffer = new uint8[Report.BatVoltage.REPORT_SIZE];
+		private uint8[] az_el_buffer = new uint8[Report.AzEl.REPORT_SIZE];
+		private uint8[] stop_buffer = new uint8[Report.Stop.REPORT_SIZE];
+		private uint8[] stream_buffer = new uint8[Report.StatusStream.REPORT_SIZE];
+		private uint8[] telemetry_buffer = new uint8[Report.Telemetry.REPORT_SIZE];
+
+		//! opened device path
+		public string path { get; private set; default = ""; }
+		//! opened device serial number, empty if board has none
+		public string serial { get; private set; default = ""; }
+
 		public static HIDConn? open(int index = 0) throws FileError {
+			return open_match(index, null);
+		}
+
+		/**
+		 * Open device with serial number
+		 */
+		public static HIDConn? open_serial(string serial) throws FileError {
+			return open_match(-1, serial);
+		}
+
+		/**
+		 * Open device by index or serial number
+		 *
+		 * Spec forms:
+		 *  - "#N"    - enumeration index
+		 *  - "sn:S"  - serial number
+		 *  - "S"     - serial number, if no board has it and S is a number,
+		 *              enumeration index (old form)
+		 *
+		 * @param spec device spec
+		 */
+		public static HIDConn? open_spec(string spec) throws FileError {
+			int64 index = 0;
+
+			if (spec.has_prefix("#")) {
+				if (!int64.try_parse(spec.substring(1), out index) || index < 0)
+					throw new FileError.INVAL(@"bad device index: $spec");
+				return open_match((int) index, null);
+			} else if (spec.has_prefix("sn:")) {
+				return open_match(-1, spec.substring(3));
+			}
+
+			try {
+				return open_match(-1, spec);
+			} catch (FileError e) {
+				if (!(e is FileError.NODEV) || !int64.try_parse(spec, out index) || index < 0)
+					throw e;
+			}
+
+			return open_match((int) index, null);
+		}
+
+		private static HIDConn? open_match(int index, string? serial) throws FileError {
 			int cur_idx = 0;
 			bool dev_found = false;
 			string dev_path = "";
+			string found_serial = "";
+			string dev_desc = (serial != null)? @"S/N $serial" : @"#$index";
 
 			debug("Enumerating:");
 			var dev = HidApi.Info.enumerate(USB_ID.VID, USB_ID.PID);
 			for (; dev != null; dev = (owned) dev.next, cur_idx++) {
+				var dev_serial = dev.serial_number_str;
+
 				debug("Device found #%d:", cur_idx);
 				debug("\tPath:         %s", dev.path);
 				debug("\tManufacturer: %s", dev.manufacturer);
 				debug("\tProduct:      %s", dev.product);
 				debug("\tRelease:      %hx", dev.release_number);
-				debug("\tS/N:          %s", dev.serial_number_str);
+				debug("\tS/N:          %s", dev_serial);
 
-				if (index == cur_idx) {
+				if ((serial == null && index == cur_idx)
+						|| (serial != null && serial == dev_serial)) {
 					dev_found = true;
 					dev_path = dev.path;
+					found_serial = dev_serial ?? "";
 				}
 			}
 
 			if (!dev_found) {
-				throw new FileError.NODEV(@"x-at rot device #$index not found");
+				throw new FileError.NODEV(@"x-at rot device $dev_desc not found");
 			}
 
 			var inst = new HIDConn();
+			inst.path = dev_path;
+			inst.serial = found_serial;
 
 			debug("Trying to open device: %s", dev_path);
 			inst.handle = HidApi.Device.open_path(dev_path);
@@ -429,7 +809,7 @@ namespace XatHid {
 				throw new FileError.ACCES(@"Could not open device: $dev_path");
 			}
 
-			message("Device #%d: %s opened.", index, dev_path);
+			message("Device %s: %s opened.", dev_desc, dev_path);
 			return inst;
 		}
 
@@ -457,6 +837,87 @@ namespace XatHid {
 		}
 		//! @}
 
+		/**
+		 * Allocation free variants
+		 * @{
+		 */
+
+		/**
+		 * Read status report into st
+		 */
+		public void read_status(ref Report.StatusData st) throws IOChannelError, ConvertError {
+			status_buffer[0] = Report.Status.REPORT_ID;
+			if (handle.get_feature_report(status_buffer) < 0) {
+				throw new IOChannelError.IO("get_feature_report");
+			}
+			st.decode(status_buffer);
+		}
+
+		/**
+		 * Read battery voltage into bv
+		 */
+		public void read_bat_voltage(ref Report.BatVoltageData bv) throws IOChannelError, ConvertError {
+			bat_voltage_buffer[0] = Report.BatVoltage.REPORT_ID;
+			if (handle.get_feature_report(bat_voltage_buffer) < 0) {
+				throw new IOChannelError.IO("get_feature_report");
+			}
+			bv.decode(bat_voltage_buffer);
+		}
+
+		/**
+		 * Read status and battery voltage in one transfer.
+		 */
+		public void read_telemetry(ref Report.TelemetryData tm) throws IOChannelError, ConvertError {
+			telemetry_buffer[0] = Report.Telemetry.REPORT_ID;
+			if (handle.get_feature_report(telemetry_buffer) < 0) {
+				throw new IOChannelError.IO("get_feature_report");
+			}
+			tm.decode(telemetry_buffer);
+		}
+
+		/**
+		 * Send new position targets
+		 */
+		public void write_az_el(Report.AzElData ae) throws IOChannelError {
+			ae.encode(az_el_buffer);
+			if (handle.write(az_el_buffer) < 0) {
+				throw new IOChannelError.IO("write report");
+			}
+		}
+
+		/**
+		 * Send stop command
+		 */
+		public void write_stop(Report.StopData st) throws IOChannelError {
+			st.encode(stop_buffer);
+			if (handle.write(stop_buffer) < 0) {
+				throw new IOChannelError.IO("write report");
+			}
+		}
+
+		/**
+		 * Wait for streamed status input report.
+		 *
+		 * May be called from other thread than other requests.
+		 *
+		 * @param timeout_ms wait time, -1 infinite
+		 * @return false on timeout
+		 */
+		public bool read_status_stream(ref Report.StatusData st, int timeout_ms) throws IOChannelError, ConvertError {
+			var ret = handle.read_timeout(stream_buffer, timeout_ms);
+			if (ret < 0) {
+				throw new IOChannelError.IO("read report");
+			} else if (ret == 0) {
+				return false;
+			} else if (ret != Report.StatusStream.REPORT_SIZE) {
+				throw new ConvertError.ILLEGAL_SEQUENCE("short input report");
+			}
+
+			st.decode_stream(stream_buffer);
+			return true;
+		}
+		//! @}
+
 		/**
 		 * Get device information report
 		 */
@@ -500,6 +961,38 @@ namespace XatHid {
 			send_feature_report((Report.IReport) ss_);
 		}
 
+		/**
+		 * Get status stream settings
+		 */
+		public Report.StreamSettings get_stream_settings() throws IOChannelError, ConvertError {
+			var ss_ = new Report.StreamSettings();
+			get_feature_report(ss_);
+			return ss_;
+		}
+
+		/**
+		 * Enable or disable status stream
+		 */
+		public void set_stream_settings(Report.StreamSettings ss_) throws IOChannelError {
+			send_feature_report((Report.IReport) ss_);
+		}
+
+		/**
+		 * Get endstop edge positions
+		 */
+		public Report.EndstopLatch get_endstop_latch() throws IOChannelError, ConvertError {
+			var el_ = new Report.EndstopLatch();
+			get_feature_report(el_);
+			return el_;
+		}
+
+		/**
+		 * Clear and arm endstop latches
+		 */
+		public void arm_endstop_latch() throws IOChannelError {
+			send_feature_report((Report.IReport) new Report.EndstopLatch());
+		}
+
 		/**
 		 * Send new position targets
 		 */
@@ -0,0 +1,811 @@
+/**
+ * HID I/O thread for X-AT ROT board
+ *
+ * Worker owns HIDConn, so blocking USB transfers never stall main loop.
+ * Commands go through lock-free SPSC queue, results are posted
+ * back to main context.
+ *
+ * Tracking goals go through separate latest-wins mailbox,
+ * flushed not faster than goal rate limit.
+ *
+ * If board streams status via interrupt IN endpoint, second thread
+ * blocks on it, and feature report polling is only a fallback.
+ *
+ * If board has Telemetry report, status and voltage are read
+ * in one transfer. Goal always goes as interrupt OUT report.
+ */
+
+namespace XatHid {
+	public enum CommandType {
+		AZ_EL,
+		STOP,
+		SET_CUR_POSITION,
+		SET_STEPPER_SETTINGS,
+		ARM_ENDSTOP_LATCH,
+		READ_ENDSTOP_LATCH
+	}
+
+	/**
+	 * Worker command. Plain struct, copied into queue.
+	 */
+	public struct Command {
+		public CommandType type;
+		public uint32 seq;
+
+		// AZ_EL, SET_CUR_POSITION: position, STOP: motors
+		public int32 azimuth;
+		public int32 elevation;
+
+		// SET_STEPPER_SETTINGS
+		public uint16 azimuth_acceleration;
+		public uint16 elevation_acceleration;
+		public uint16 azimuth_max_speed;
+		public uint16 elevation_max_speed;
+	}
+
+	/**
+	 * Lock-free single producer, single consumer command ring.
+	 *
+	 * Producer - main thread, consumer - worker thread.
+	 */
+	public class CommandQueue {
+		private Command[] ring;
+		private int head = 0;	// written only by consumer
+		private int tail = 0;	// written only by producer
+
+		public CommandQueue(int size)
+			requires(size > 1)
+		{
+			ring = new Command[size];
+		}
+
+		public bool push(Command cmd) {
+			var t = AtomicInt.get(ref tail);
+			var next = (t + 1) % ring.length;
+
+			if (next == AtomicInt.get(ref head))
+				return false;	// full
+
+			ring[t] = cmd;
+			AtomicInt.set(ref tail, next);
+			return true;
+		}
+
+		public bool pop(out Command cmd) {
+			var h = AtomicInt.get(ref head);
+
+			if (h == AtomicInt.get(ref tail)) {
+				cmd = Command();
+				return false;	// empty
+			}
+
+			cmd = ring[h];
+			AtomicInt.set(ref head, (h + 1) % ring.length);
+			return true;
+		}
+	}
+
+	/**
+	 * Device time of status stream.
+	 *
+	 * Board counts 32 bit microseconds, that wraps every 71.6 min,
+	 * so it is extended to 64 bit by signed difference to last report.
+	 */
+	internal struct DeviceClock {
+		private const int64 OFFSET_WINDOW_US = 5000000;
+
+		private bool valid;
+		private uint32 last;
+		private int64 stamp;
+
+		// host - device time, minimum over window
+		private int64 offset;
+		private int64 window_min;
+		private int64 window_start;
+
+		/**
+		 * @return monotonic device time [us] since first report
+		 */
+		public int64 unwrap(uint32 device_time) {
+			if (!valid) {
+				valid = true;
+				stamp = device_time;
+			} else {
+				stamp += (int32) (device_time - last);
+			}
+
+			last = device_time;
+			return stamp;
+		}
+
+		/**
+		 * Estimate host time when report was made.
+		 *
+		 * Offset is minimum of receive minus device time, so it includes
+		 * smallest transfer delay. It is renewed each window to follow drift.
+		 *
+		 * @param stamp   unwrapped device time [us]
+		 * @param rx_time host receive time [us]
+		 */
+		public int64 to_host(int64 stamp, int64 rx_time) {
+			var d = rx_time - stamp;
+
+			if (window_start == 0) {
+				offset = d;
+				window_min = d;
+				window_start = rx_time;
+			}
+
+			offset = int64.min(offset, d);
+			window_min = int64.min(window_min, d);
+			if (rx_time - window_start >= OFFSET_WINDOW_US) {
+				offset = window_min;
+				window_min = int64.MAX;
+				window_start = rx_time;
+			}
+
+			return stamp + offset;
+		}
+	}
+
+	/**
+	 * Main context source for worker results.
+	 *
+	 * Persistent and woken by flag, so posting results does not allocate.
+	 */
+	internal class ResultSource : Source {
+		private int pending = 0;
+
+		public void post() {
+			AtomicInt.set(ref pending, 1);
+
+			unowned MainContext? ctx = get_context();
+			if (ctx != null)
+				ctx.wakeup();
+		}
+
+		protected override bool prepare(out int timeout) {
+			timeout = -1;
+			return AtomicInt.get(ref pending) != 0;
+		}
+
+		protected override bool check() {
+			return AtomicInt.get(ref pending) != 0;
+		}
+
+		protected override bool dispatch(SourceFunc? callback) {
+			AtomicInt.set(ref pending, 0);
+			return callback();
+		}
+	}
+
+	public class Worker : Object {
+		/**
+		 * Status report in last_status, reflects all commands up to cmd_seq.
+		 *
+		 * Struct is not passed as signal argument, that would box a copy
+		 * on each emission.
+		 */
+		public signal void status_received(uint32 cmd_seq);
+		public signal void bat_voltage_received(Report.BatVoltageData bat_voltage);
+		public signal void endstop_latch_received(Report.EndstopLatchData latch, uint32 cmd_seq);
+		public signal void io_error(string msg);
+
+		/**
+		 * Traced goal written to device, or skipped as already there,
+		 * monotonic times [us]
+		 */
+		public signal void goal_written(int64 origin, int64 queued, int64 written);
+
+		/**
+		 * Last status, main context side
+		 */
+		public Report.StatusData last_status;
+
+		private const int QUEUE_SIZE = 64;
+		private const int STREAM_TIMEOUT_MS = 100;
+		private const ulong STREAM_ERROR_DELAY_US = 500000;
+		private const int64 STREAM_SEQ_MARGIN_US = 2000;	// covers transfer delay in device clock offset
+
+		private HIDConn conn;
+		private CommandQueue queue;
+		private Thread<void*>? thread = null;
+		private Thread<void*>? stream_thread = null;
+		private int running = 0;
+		private uint32 last_seq = 0;	// producer side
+		private int _done_seq = 0;	// last executed command, worker side
+
+		// last executed command and its completion time, for stream reports
+		private Mutex done_mutex = Mutex();
+		private uint32 done_cmd_seq = 0;
+		private int64 done_cmd_time = 0;
+
+		/**
+		 * Read status stream in separate thread. Set before start().
+		 */
+		public bool streaming { get; set; default = false; }
+
+		/**
+		 * Use combined Telemetry report. Set before start().
+		 */
+		public bool telemetry { get; set; default = false; }
+
+		/**
+		 * First poll delay [us]. Set before start().
+		 *
+		 * Boards in one process get different phases,
+		 * so their status and voltage polls do not hit USB bus at once.
+		 * Goal writes are not delayed to spread them, they go out
+		 * as soon as goal arrives and rate limit allows.
+		 */
+		public int64 poll_offset_us { get; set; default = 0; }
+
+		// polling rates
+		private int _status_period_ms = 100;
+		private int _bat_voltage_period_ms = 1000;
+
+		public int status_period_ms {
+			get { return AtomicInt.get(ref _status_period_ms); }
+			set { AtomicInt.set(ref _status_period_ms, value); wakeup(); }
+		}
+
+		public int bat_voltage_period_ms {
+			get { return AtomicInt.get(ref _bat_voltage_period_ms); }
+			set { AtomicInt.set(ref _bat_voltage_period_ms, value); wakeup(); }
+		}
+
+		// goal output rate limit
+		private int _goal_period_us = 0;
+
+		public int goal_period_us {
+			get { return AtomicInt.get(ref _goal_period_us); }
+			set { AtomicInt.set(ref _goal_period_us, value); wakeup(); }
+		}
+
+		// goal mailbox, guarded by goal_mutex
+		private Mutex goal_mutex = Mutex();
+		private bool goal_pending = false;
+		private int32 goal_az = 0;
+		private int32 goal_el = 0;
+		private int64 goal_origin = 0;
+		private int64 goal_queued = 0;
+
+		// last sent goal, worker side
+		private bool last_goal_valid = false;
+		private int32 last_goal_az = 0;
+		private int32 last_goal_el = 0;
+		private int64 next_goal_time = 0;
+
+		// goal statistics
+		private int _goals_coalesced = 0;
+		private int _goals_skipped = 0;
+
+		/**
+		 * Goals replaced in mailbox by newer one before sending
+		 */
+		public int goals_coalesced {
+			get { return AtomicInt.get(ref _goals_coalesced); }
+		}
+
+		/**
+		 * Goals not sent because steps equal to last sent
+		 */
+		public int goals_skipped {
+			get { return AtomicInt.get(ref _goals_skipped); }
+		}
+
+		// worker wakeup
+		private Mutex wake_mutex = Mutex();
+		private Cond wake_cond = Cond();
+		private bool wake_pending = false;
+
+		// results for main context, guarded by result_mutex
+		private Mutex result_mutex = Mutex();
+		private ResultSource result_source;
+		private bool status_pending = false;
+		private Report.StatusData pending_status;
+		private uint32 pending_status_seq = 0;
+		private bool bat_voltage_pending = false;
+		private Report.BatVoltageData pending_bat_voltage;
+		private bool latch_pending = false;
+		private Report.EndstopLatchData pending_latch;
+		private uint32 pending_latch_seq = 0;
+		private bool goal_trace_pending = false;
+		private int64 pending_goal_origin = 0;
+		private int64 pending_goal_queued = 0;
+		private int64 pending_goal_written = 0;
+		private string? pending_error = null;
+		private int64 last_stream_time = 0;
+
+		// worker side report storage
+		private Report.StatusData status;
+		private Report.BatVoltageData bat_voltage;
+		private Report.TelemetryData telemetry_data;
+
+		// poll schedule, worker side
+		private int64 next_status = 0;
+		private int64 next_bat_voltage = 0;
+
+		public Worker(HIDConn conn) {
+			this.conn = conn;
+			queue = new CommandQueue(QUEUE_SIZE);
+			result_source = new ResultSource();
+			result_source.set_callback(dispatch_results);
+		}
+
+		public void start() {
+			return_if_fail(thread == null);
+
+			result_source.attach(MainContext.default());
+
+			AtomicInt.set(ref running, 1);
+			thread = new Thread<void*>("hid-worker", run);
+			if (streaming)
+				stream_thread = new Thread<void*>("hid-stream", run_stream);
+		}
+
+		/**
+		 * Stop thread. Already queued commands are executed before exit.
+		 */
+		public void stop() {
+			if (thread == null)
+				return;
+
+			AtomicInt.set(ref running, 0);
+			wakeup();
+			thread.join();
+			thread = null;
+			if (stream_thread != null) {
+				stream_thread.join();
+				stream_thread = null;
+			}
+
+			result_source.destroy();
+		}
+
+		//! commands, called from main thread @{
+
+		/**
+		 * Queue command.
+		 *
+		 * @return command sequence number, compare with status_received cmd_seq
+		 */
+		public uint32 push(Command cmd) {
+			cmd.seq = ++last_seq;
+			if (!queue.push(cmd))
+				warning("HID worker queue full, command %d dropped", cmd.type);
+
+			wakeup();
+			return cmd.seq;
+		}
+
+		public uint32 send_az_el(int32 az, int32 el) {
+			return push(Command() { type = CommandType.AZ_EL, azimuth = az, elevation = el });
+		}
+
+		/**
+		 * Set tracking goal. Latest wins, not yet sent goal is replaced.
+		 *
+		 * Replaced goal passes its trace on, so the earliest traced
+		 * origin is measured, not dropped by an untraced goal.
+		 *
+		 * @param origin latency trace origin [us], 0 if not traced
+		 */
+		public void set_goal(int32 az, int32 el, int64 origin = 0) {
+			var now = get_monotonic_time();
+
+			goal_mutex.lock();
+			if (goal_pending)
+				AtomicInt.inc(ref _goals_coalesced);
+
+			if (!goal_pending || goal_origin == 0) {
+				goal_origin = origin;
+				goal_queued = now;
+			}
+
+			goal_pending = true;
+			goal_az = az;
+			goal_el = el;
+			goal_mutex.unlock();
+
+			wakeup();
+		}
+
+		/**
+		 * Drop not yet sent goal.
+		 */
+		public void clear_goal() {
+			goal_mutex.lock();
+			goal_pending = false;
+			goal_mutex.unlock();
+		}
+
+		/**
+		 * Stop motors, pending goal is dropped.
+		 */
+		public uint32 send_stop(bool az, bool el) {
+			clear_goal();
+			return push(Command() { type = CommandType.STOP, azimuth = az? 1 : 0, elevation = el? 1 : 0 });
+		}
+
+		public uint32 set_cur_position(int32 az, int32 el) {
+			return push(Command() { type = CommandType.SET_CUR_POSITION, azimuth = az, elevation = el });
+		}
+
+		public uint32 set_stepper_settings(Report.StepperSettings ss) {
+			return push(Command() {
+					type = CommandType.SET_STEPPER_SETTINGS,
+					azimuth_acceleration = ss.azimuth_acceleration,
+					elevation_acceleration = ss.elevation_acceleration,
+					azimuth_max_speed = ss.azimuth_max_speed,
+					elevation_max_speed = ss.elevation_max_speed
+				});
+		}
+
+		/**
+		 * Clear endstop latches, next edges will be captured.
+		 */
+		public uint32 arm_endstop_latch() {
+			return push(Command() { type = CommandType.ARM_ENDSTOP_LATCH });
+		}
+
+		/**
+		 * Request latched edges, result in endstop_latch_received.
+		 */
+		public uint32 read_endstop_latch() {
+			return push(Command() { type = CommandType.READ_ENDSTOP_LATCH });
+		}
+		//! @}
+
+		private void wakeup() {
+			wake_mutex.lock();
+			wake_pending = true;
+			wake_cond.signal();
+			wake_mutex.unlock();
+		}
+
+		//! worker thread @{
+
+		private void execute(Command cmd) throws Error {
+			switch (cmd.type) {
+			case CommandType.AZ_EL:
+				conn.write_az_el({ cmd.azimuth, cmd.elevation });
+				break;
+
+			case CommandType.STOP:
+				uint8 motor = 0;
+				if (cmd.azimuth != 0)
+					motor |= Report.Stop.Motor.AZ;
+				if (cmd.elevation != 0)
+					motor |= Report.Stop.Motor.EL;
+
+				conn.write_stop({ motor });
+				break;
+
+			case CommandType.SET_CUR_POSITION:
+				conn.set_cur_position(new Report.CurPosition.with_data(cmd.azimuth, cmd.elevation));
+				break;
+
+			case CommandType.SET_STEPPER_SETTINGS:
+				var ss = new Report.StepperSettings();
+				ss.azimuth_acceleration = cmd.azimuth_acceleration;
+				ss.elevation_acceleration = cmd.elevation_acceleration;
+				ss.azimuth_max_speed = cmd.azimuth_max_speed;
+				ss.elevation_max_speed = cmd.elevation_max_speed;
+				conn.set_stepper_settings(ss);
+				break;
+
+			case CommandType.ARM_ENDSTOP_LATCH:
+				conn.arm_endstop_latch();
+				break;
+
+			case CommandType.READ_ENDSTOP_LATCH:
+				var latch = conn.get_endstop_latch();
+				post_endstop_latch(latch.data, cmd.seq);
+				break;
+			}
+		}
+
+		private uint32 drain_queue() {
+			Command cmd;
+			uint32 done_seq = 0;
+
+			while (queue.pop(out cmd)) {
+				try {
+					execute(cmd);
+				} catch (Error e) {
+					post_error(@"command $(cmd.type): $(e.message)");
+				}
+				done_seq = cmd.seq;
+
+				// target or position changed by command, resend next goal
+				last_goal_valid = false;
+			}
+
+			return done_seq;
+		}
+
+		/**
+		 * Send pending goal if rate limit allows.
+		 *
+		 * @return time when pending goal may be sent, int64.MAX if none
+		 */
+		private int64 flush_goal(int64 now) {
+			int32 az, el;
+			int64 origin, queued;
+
+			goal_mutex.lock();
+			var pending = goal_pending;
+			if (pending && now >= next_goal_time)
+				goal_pending = false;
+			az = goal_az;
+			el = goal_el;
+			origin = goal_origin;
+			queued = goal_queued;
+			goal_mutex.unlock();
+
+			if (!pending)
+				return int64.MAX;
+			if (now < next_goal_time)
+				return next_goal_time;
+
+			// device already has it, trace ends here
+			if (last_goal_valid && az == last_goal_az && el == last_goal_el) {
+				AtomicInt.inc(ref _goals_skipped);
+				if (origin != 0)
+					post_goal_trace(origin, queued, now);
+				return int64.MAX;
+			}
+
+			try {
+				conn.write_az_el({ az, el });
+				last_goal_valid = true;
+				last_goal_az = az;
+				last_goal_el = el;
+
+				if (origin != 0)
+					post_goal_trace(origin, queued, get_monotonic_time());
+			} catch (Error e) {
+				post_error(@"goal: $(e.message)");
+			}
+
+			next_goal_time = now + goal_period_us;
+			return int64.MAX;
+		}
+
+		/**
+		 * Stream delivered status recently, polling not needed.
+		 */
+		private bool is_stream_fresh(int64 now) {
+			if (stream_thread == null)
+				return false;
+
+			result_mutex.lock();
+			var t = last_stream_time;
+			result_mutex.unlock();
+
+			return t != 0 && (now - t) < 2 * status_period_ms * 1000;
+		}
+
+		private void* run() {
+			next_status = get_monotonic_time() + poll_offset_us;
+			next_bat_voltage = next_status;
+
+			while (AtomicInt.get(ref running) != 0) {
+				var seq = drain_queue();
+				if (seq != 0) {
+					AtomicInt.set(ref _done_seq, (int) seq);
+
+					done_mutex.lock();
+					done_cmd_seq = seq;
+					done_cmd_time = get_monotonic_time();
+					done_mutex.unlock();
+				}
+
+				var now = get_monotonic_time();
+				var next_goal = flush_goal(now);
+
+				var status_due = false;
+				if (now >= next_status) {
+					next_status = now + status_period_ms * 1000;
+					status_due = !is_stream_fresh(now);
+				}
+
+				var bat_voltage_due = false;
+				if (now >= next_bat_voltage) {
+					next_bat_voltage = now + bat_voltage_period_ms * 1000;
+					bat_voltage_due = true;
+				}
+
+				if (telemetry && (status_due || bat_voltage_due)) {
+					// one transfer for both, status always posted
+					try {
+						conn.read_telemetry(ref telemetry_data);
+						post_telemetry(bat_voltage_due);
+					} catch (Error e) {
+						post_error(@"get_telemetry: $(e.message)");
+					}
+				} else {
+					if (status_due) {
+						try {
+							conn.read_status(ref status);
+							post_status(status, (uint32) AtomicInt.get(ref _done_seq));
+						} catch (Error e) {
+							post_error(@"get_status: $(e.message)");
+						}
+					}
+
+					if (bat_voltage_due) {
+						try {
+							conn.read_bat_voltage(ref bat_voltage);
+							post_bat_voltage();
+						} catch (Error e) {
+							post_error(@"get_bat_voltage: $(e.message)");
+						}
+					}
+				}
+
+				// sleep until next poll or new command
+				var deadline = int64.min(int64.min(next_status, next_bat_voltage), next_goal);
+				wake_mutex.lock();
+				while (!wake_pending && AtomicInt.get(ref running) != 0) {
+					if (!wake_cond.wait_until(wake_mutex, deadline))
+						break;
+				}
+				wake_pending = false;
+				wake_mutex.unlock();
+			}
+
+			// last commands (stop)
+			drain_queue();
+			return null;
+		}
+
+		/**
+		 * Status stream thread.
+		 *
+		 * Report is tagged with last executed command seq only when
+		 * its device time, mapped to host clock, is after that command
+		 * completed. Report made before command but read after it keeps
+		 * older tag, so wait_status(seq) never gets stale status.
+		 */
+		private void* run_stream() {
+			Report.StatusData st = {};
+			DeviceClock clock = {};
+			uint32 seq = 0;
+
+			while (AtomicInt.get(ref running) != 0) {
+				try {
+					if (!conn.read_status_stream(ref st, STREAM_TIMEOUT_MS))
+						continue;
+
+					var now = get_monotonic_time();
+					st.device_stamp = clock.unwrap(st.device_time);
+					var made = clock.to_host(st.device_stamp, now);
+
+					done_mutex.lock();
+					var cmd_seq = done_cmd_seq;
+					var cmd_time = done_cmd_time;
+					done_mutex.unlock();
+
+					if (cmd_seq != seq && made >= cmd_time + STREAM_SEQ_MARGIN_US)
+						seq = cmd_seq;
+
+					result_mutex.lock();
+					last_stream_time = now;
+					result_mutex.unlock();
+
+					post_status(st, seq);
+				} catch (Error e) {
+					post_error(@"status stream: $(e.message)");
+					Thread.usleep(STREAM_ERROR_DELAY_US);
+				}
+			}
+
+			return null;
+		}
+
+		/**
+		 * Post telemetry status, voltage only when its poll is due.
+		 */
+		private void post_telemetry(bool bat_voltage_due) {
+			post_status(telemetry_data.status, (uint32) AtomicInt.get(ref _done_seq));
+
+			if (bat_voltage_due) {
+				bat_voltage = telemetry_data.bat_voltage;
+				post_bat_voltage();
+			}
+		}
+
+		internal void post_status(Report.StatusData st, uint32 seq) {
+			result_mutex.lock();
+			status_pending = true;
+			pending_status = st;
+			pending_status_seq = seq;
+			result_mutex.unlock();
+
+			result_source.post();
+		}
+
+		private void post_bat_voltage() {
+			result_mutex.lock();
+			bat_voltage_pending = true;
+			pending_bat_voltage = bat_voltage;
+			result_mutex.unlock();
+
+			result_source.post();
+		}
+
+		private void post_endstop_latch(Report.EndstopLatchData latch, uint32 seq) {
+			result_mutex.lock();
+			latch_pending = true;
+			pending_latch = latch;
+			pending_latch_seq = seq;
+			result_mutex.unlock();
+
+			result_source.post();
+		}
+
+		private void post_goal_trace(int64 origin, int64 queued, int64 written) {
+			result_mutex.lock();
+			goal_trace_pending = true;
+			pending_goal_origin = origin;
+			pending_goal_queued = queued;
+			pending_goal_written = written;
+			result_mutex.unlock();
+
+			result_source.post();
+		}
+
+		private void post_error(string msg) {
+			result_mutex.lock();
+			pending_error = msg;
+			result_mutex.unlock();
+
+			result_source.post();
+		}
+		//! @}
+
+		// main context: emit signals for collected results
+		internal bool dispatch_results() {
+			Report.StatusData st = {};
+			Report.BatVoltageData bv = {};
+			Report.EndstopLatchData latch = {};
+
+			result_mutex.lock();
+			var has_status = status_pending;
+			var has_bat_voltage = bat_voltage_pending;
+			var status_seq = pending_status_seq;
+			var has_latch = latch_pending;
+			var latch_seq = pending_latch_seq;
+			var has_goal_trace = goal_trace_pending;
+			var trace_origin = pending_goal_origin;
+			var trace_queued = pending_goal_queued;
+			var trace_written = pending_goal_written;
+			var err = (owned) pending_error;
+			st = pending_status;
+			bv = pending_bat_voltage;
+			latch = pending_latch;
+			latch_pending = false;
+			goal_trace_pending = false;
+			status_pending = false;
+			bat_voltage_pending = false;
+			result_mutex.unlock();
+
+			if (err != null)
+				io_error(err);
+			if (has_status) {
+				last_status = st;
+				status_received(status_seq);
+			}
+			if (has_bat_voltage)
+				bat_voltage_received(bv);
+			if (has_latch)
+				endstop_latch_received(latch, latch_seq);
+			if (has_goal_trace)
+				goal_written(trace_origin, trace_queued, trace_written);
+
+			return true;
+		}
+	}
+}
@@ -0,0 +1,61 @@
+/**
+ * udev monitor for X-AT ROT boards.
+ *
+ * Watches hidraw add events and reports those of ROT VID/PID,
+ * so disconnected boards are reopened as soon as they reappear.
+ */
+class HotPlug : Object {
+	public signal void device_added(string devnode);
+
+	private Udev.Context udev;
+	private Udev.Monitor monitor;
+	private IOChannel iochannel;
+
+	public HotPlug() throws IOChannelError {
+		udev = new Udev.Context();
+		if (udev == null)
+			throw new IOChannelError.FAILED("udev_new");
+
+		monitor = new Udev.Monitor.from_netlink(udev, "udev");
+		if (monitor == null)
+			throw new IOChannelError.FAILED("udev_monitor_new_from_netlink");
+
+		monitor.filter_add_match_subsystem_devtype("hidraw");
+		if (monitor.enable_receiving() < 0)
+			throw new IOChannelError.FAILED("udev_monitor_enable_receiving");
+
+		iochannel = new IOChannel.unix_new(monitor.get_fd());
+		iochannel.add_watch(IOCondition.IN, (source, condition) => {
+				handle_event();
+				return true;
+			});
+	}
+
+	private static bool is_rot(Udev.Device dev) {
+		unowned Udev.Device? usb = dev.get_parent_with_subsystem_devtype("usb", "usb_device");
+		if (usb == null)
+			return false;
+
+		var vid = usb.get_sysattr_value("idVendor");
+		var pid = usb.get_sysattr_value("idProduct");
+		if (vid == null || pid == null)
+			return false;
+
+		// sysfs ids are 4 digit lower case hex
+		return vid == "%04x".printf(XatHid.USB_ID.VID)
+			&& pid == "%04x".printf(XatHid.USB_ID.PID);
+	}
+
+	private void handle_event() {
+		var dev = monitor.receive_device();
+		if (dev == null)
+			return;
+
+		var action = dev.get_action();
+		var devnode = dev.get_devnode();
+		if (action == "add" && devnode != null && is_rot(dev)) {
+			debug("Hotplug: ROT device %s added", devnode);
+			device_added(devnode);
+		}
+	}
+}
@@ -0,0 +1,943 @@
+/**
+ * One X-AT ROT board driven by rotd.
+ *
+ * Owns HID connection, I/O worker, homing process and LCM channels
+ * of that board, so several boards may run in one process.
+ *
+ * On I/O error board is closed and reopened when it reappears,
+ * then settings, position and last goal are restored.
+ */
+
+using XatHid.Report;
+
+
+class RotDevice : Object {
+	/**
+	 * Board fatal I/O error, only if reconnect disabled
+	 */
+	public signal void io_error(string msg);
+
+	public string name { get; private set; }
+
+	/**
+	 * Device index or serial number
+	 */
+	public string spec { get; private set; }
+
+	public bool connected { get; private set; default = false; }
+
+	//! LCM channels @{
+	public string goal_channel { get; private set; }
+	public string state_channel { get; private set; }
+	public string bat_voltage_channel { get; private set; }
+	//! @}
+
+	public bool homing_in_proc { get; private set; default = false; }
+
+	/**
+	 * Two-phase homing: fast seek, then slow approach from negative side
+	 */
+	public bool fast_homing = false;
+
+	/**
+	 * Fast homing: back off distance before slow approach [rad].
+	 * Should be greater than endstop zone plus stopping distance.
+	 */
+	public double homing_backoff = 10.0 * Math.PI / 180.0;
+
+	/**
+	 * Calibration state file, null - always start uncalibrated
+	 */
+	public CalibStore? calib_store = null;
+
+	/**
+	 * Allowed position mismatch to resume calibration [rad]
+	 */
+	public double calib_tolerance = 1.0 * Math.PI / 180.0;
+
+	/**
+	 * Zero position known (homed or resumed)
+	 */
+	public bool homed { get; private set; default = false; }
+
+	//! I/O options @{
+	public bool use_stream = true;
+	public int stream_rate = 50;		// [Hz], 0 only on change
+	public bool use_telemetry = true;
+	public int goal_rate = 50;		// [Hz], 0 unlimited
+	public int64 poll_offset_us = 0;	// status poll phase, spreads USB traffic of boards
+	public bool reconnect = true;		// reopen board after I/O error
+	public string goal_node = "trakd";	// clock of goal stamps, for latency trace
+	//! @}
+
+	// polling rates
+	public const int STATUS_PERIOD_MS = 100;	// -> 10 Hz
+	public const int BAT_VOLTAGE_PERIOD_MS = 1000;	// ->  1 Hz
+	public const int HOMING_PERIOD_MS = 50;	// -> 20 Hz
+
+	private XatHid.HIDConn? conn = null;
+	private XatHid.Worker? worker = null;
+	private unowned Lcm.LcmNode lcm;
+
+	// header data
+	private xat_msgs.HeaderFiller status_header;
+	private xat_msgs.HeaderFiller bat_voltage_header;
+
+	// motor settings, shared by all boards
+	private MotConv az_mc;
+	private MotConv el_mc;
+	private StepperSettings homing_settings;
+	private StepperSettings tracking_settings;
+
+	// homing
+	private Cancellable homing_cancelable;
+	private uint32 homing_seq = 0;	// last homing move
+
+	// status waiter of homing process
+	private SourceFunc? status_waiter = null;
+	private uint32 status_wait_seq = 0;
+	private StatusData waited_status;
+
+	// state message reused for each status
+	private xat_msgs.joint_state_t state_msg;
+	private JointStateEncoder state_encoder;
+
+	// calibration state
+	private const int64 CALIB_SAVE_PERIOD_US = 1000000;
+	private CalibStore.Entry calib;
+	private int64 calib_save_time = 0;
+	private bool need_homing = false;
+	private bool goal_valid = false;
+
+	// reconnect
+	private const uint RECONNECT_PERIOD_MS = 1000;
+	private uint reconnect_timer = 0;
+	private string? reopen_spec = null;	// spec of board opened first
+
+	// device features
+	private bool streaming = false;
+	private bool telemetry = false;
+	private bool endstop_latch = false;
+
+	/**
+	 * @param name device name, null - single device on legacy channels
+	 */
+	public RotDevice(string? name, string spec, Lcm.LcmNode lcm,
+			MotConv az_mc, MotConv el_mc,
+			StepperSettings homing_settings, StepperSettings tracking_settings) {
+		this.name = name ?? "rot";
+		this.spec = spec;
+		this.lcm = lcm;
+		this.az_mc = az_mc;
+		this.el_mc = el_mc;
+		this.homing_settings = homing_settings;
+		this.tracking_settings = tracking_settings;
+
+		if (name == null) {
+			goal_channel = "xat/rot/goal";
+			state_channel = "xat/rot/state";
+			bat_voltage_channel = "xat/battery_voltage";
+		} else {
+			goal_channel = @"xat/rot/$name/goal";
+			state_channel = @"xat/rot/$name/state";
+			bat_voltage_channel = @"xat/rot/$name/battery_voltage";
+		}
+
+		status_header = new xat_msgs.HeaderFiller();
+		bat_voltage_header = new xat_msgs.HeaderFiller();
+
+		state_msg = new xat_msgs.joint_state_t();
+		state_msg.header = new xat_msgs.header_t();
+		state_encoder = new JointStateEncoder();
+
+		// homing canceled by default
+		homing_cancelable = new Cancellable();
+		homing_cancelable.cancel();
+		homing_cancelable.cancelled.connect(wake_status_waiter);
+	}
+
+	// -*- helpers -*-
+
+	private void debug_status(Status s) {
+		debug("%s status:", name);
+		debug(@"\tFlags:   %s%s", s.az_in_motion? "AZ_IN_MOTION " : "", s.el_in_motion? "EL_IN_MOTION" : "");
+		debug(@"\tButtons: %s%s", s.az_endstop? "AZ_ENDSTOP " : "", s.el_endstop? "EL_ENDSTOP" : "");
+		debug(@"\tAZ position: $(s.azimuth_position)");
+		debug(@"\tEL position: $(s.elevation_position)");
+	}
+
+	/**
+	 * Open board and setup it
+	 */
+	public void open() throws Error {
+		conn = XatHid.HIDConn.open_spec(reopen_spec ?? spec);
+		if (reopen_spec == null)
+			pin_device();
+
+		try {
+			setup();
+		} catch (Error e) {
+			conn = null;
+			throw e;
+		}
+	}
+
+	/**
+	 * Initial setup, done synchronously before worker starts.
+	 */
+	private void setup() throws IOChannelError, ConvertError {
+		// get device caps
+		var devinfo = conn.get_info();
+		message("%s: Device caps: %s", name, devinfo.device_caps_str);
+		streaming = use_stream && devinfo.has_cap(Info.CAP_STATUS_STREAM);
+		telemetry = use_telemetry && devinfo.has_cap(Info.CAP_TELEMETRY);
+		if (telemetry)
+			message("%s: Using combined telemetry report", name);
+		endstop_latch = devinfo.has_cap(Info.CAP_ENDSTOP_LATCH);
+
+		// log current status, before stop: motion tells that board kept its target
+		var status = conn.get_status();
+		debug_status(status);
+
+		// stop motors
+		conn.send_stop(new Stop.with_data(true, true));
+
+		// resume calibration if board kept its counters
+		need_homing = false;
+		if (homed)
+			restore_position(status);
+		else if (calib_store != null)
+			check_calibration(status);
+
+		// get old settings
+		var old_ss = conn.get_stepper_settings();
+		RotD.debug_stepper_settings(old_ss, "Old");
+
+		// apply new settings
+		message("%s: Apply tracking settings", name);
+		conn.set_stepper_settings(tracking_settings);
+
+		// status via interrupt endpoint
+		if (streaming) {
+			var period = (stream_rate > 0)? 1000 / stream_rate : 0;
+			message("%s: Enable status stream, period %d ms", name, period);
+			conn.set_stream_settings(new StreamSettings.with_data(true, (uint16) period));
+		}
+	}
+
+	/**
+	 * Start I/O thread, it polls status and voltage
+	 */
+	public void start() {
+		worker = new XatHid.Worker(conn);
+		worker.streaming = streaming;
+		worker.telemetry = telemetry;
+		worker.poll_offset_us = poll_offset_us;
+		worker.status_period_ms = STATUS_PERIOD_MS;
+		worker.bat_voltage_period_ms = BAT_VOLTAGE_PERIOD_MS;
+		worker.goal_period_us = (goal_rate > 0)? 1000000 / goal_rate : 0;
+		worker.status_received.connect(handle_status);
+		worker.bat_voltage_received.connect(handle_bat_voltage);
+		worker.io_error.connect(handle_worker_error);
+		worker.goal_written.connect(handle_goal_written);
+		worker.start();
+		connected = true;
+
+		// replay newest goal after reconnect
+		if (homed && goal_valid)
+			worker.set_goal(calib.azimuth_goal, calib.elevation_goal);
+
+		if (need_homing) {
+			message("%s: Not calibrated, start homing", name);
+			start_homing();
+		}
+	}
+
+	/**
+	 * Stop motors and I/O thread
+	 */
+	public void stop() {
+		if (reconnect_timer != 0) {
+			Source.remove(reconnect_timer);
+			reconnect_timer = 0;
+		}
+
+		homing_cancelable.cancel();
+		save_calibration(true);
+		if (!connected)
+			return;
+
+		worker.send_stop(true, true);
+		worker.stop();
+		connected = false;
+
+		if (streaming) {
+			try {
+				conn.set_stream_settings(new StreamSettings.with_data(false, 0));
+			} catch (IOChannelError e) {
+				warning("%s: Disable status stream: %s", name, e.message);
+			}
+		}
+	}
+
+	// -*- reconnect -*-
+
+	/**
+	 * Remember opened board, so reconnect does not pick another one.
+	 *
+	 * Enumeration index shifts when other boards come and go,
+	 * so board without serial number is not reopened.
+	 */
+	private void pin_device() {
+		if (conn.serial != "") {
+			reopen_spec = @"sn:$(conn.serial)";
+		} else if (reconnect) {
+			warning("%s: Board %s has no serial number, reconnect disabled", name, conn.path);
+			reconnect = false;
+		}
+	}
+
+	private void handle_worker_error(string msg) {
+		if (!reconnect) {
+			io_error(msg);
+			return;
+		}
+
+		if (!connected)
+			return;
+
+		critical("%s: HID error: %s, waiting for reconnect", name, msg);
+		connected = false;
+
+		// worker still dispatches results, release it later
+		Idle.add(() => {
+				disconnect();
+				return false;
+			});
+	}
+
+	private void disconnect() {
+		homing_cancelable.cancel();
+
+		// stopped worker kept until reconnect, cancelled homing may still push to it
+		worker.stop();
+		conn = null;
+		save_calibration(true);
+
+		// fallback if udev event missed
+		reconnect_timer = Timeout.add(RECONNECT_PERIOD_MS, () => {
+				try_reconnect();
+				if (connected) {
+					reconnect_timer = 0;
+					return false;
+				}
+				return true;
+			});
+	}
+
+	/**
+	 * Try to reopen disconnected board.
+	 */
+	public void try_reconnect() {
+		// not disconnected or old worker not stopped yet
+		if (connected || reconnect_timer == 0)
+			return;
+
+		try {
+			open();
+		} catch (Error e) {
+			debug("%s: Reconnect: %s", name, e.message);
+			return;
+		}
+
+		start();
+		message("%s: Reconnected", name);
+
+		if (reconnect_timer != 0) {
+			Source.remove(reconnect_timer);
+			reconnect_timer = 0;
+		}
+	}
+
+	// -*- calibration state -*-
+
+	// pos between a and b with tolerance
+	private static bool in_range(int32 pos, int32 a, int32 b, int32 tol) {
+		return pos >= int32.min(a, b) - tol && pos <= int32.max(a, b) + tol;
+	}
+
+	// pos equal to a or b with tolerance
+	private static bool near_either(int32 pos, int32 a, int32 b, int32 tol) {
+		return (pos - a).abs() <= tol || (pos - b).abs() <= tol;
+	}
+
+	/**
+	 * Check that board counters survived since state e was saved.
+	 *
+	 * Board has no boot id, and after power loss it reads zero and stands.
+	 * Moving board still runs to target sent before, so it may be
+	 * anywhere between saved position and last goal. Standing board
+	 * should be at one of them, and exact zero is not trusted.
+	 */
+	private bool counters_kept(Status s, CalibStore.Entry e) {
+		var az_tol = angle_steps(az_mc, calib_tolerance);
+		var el_tol = angle_steps(el_mc, calib_tolerance);
+
+		if (s.az_in_motion || s.el_in_motion)
+			return in_range(s.azimuth_position, e.azimuth_position, e.azimuth_goal, az_tol)
+				&& in_range(s.elevation_position, e.elevation_position, e.elevation_goal, el_tol);
+
+		if (s.azimuth_position == 0 && s.elevation_position == 0)
+			return false;
+
+		return near_either(s.azimuth_position, e.azimuth_position, e.azimuth_goal, az_tol)
+			&& near_either(s.elevation_position, e.elevation_position, e.elevation_goal, el_tol);
+	}
+
+	/**
+	 * Compare board position with saved state.
+	 */
+	private void check_calibration(Status s) {
+		CalibStore.Entry e;
+
+		if (!calib_store.lookup(name, out e) || !e.homed) {
+			message("%s: No saved calibration", name);
+			need_homing = true;
+			return;
+		}
+
+		if (counters_kept(s, e)) {
+			message("%s: Calibration resumed", name);
+			calib = e;
+			homed = true;
+		} else {
+			warning("%s: Saved calibration does not match board position, power lost?", name);
+			need_homing = true;
+		}
+	}
+
+	/**
+	 * Reopened board: keep counters if they survived,
+	 * else board was reset, restore last known position.
+	 */
+	private void restore_position(Status s) throws IOChannelError {
+		if (counters_kept(s, calib))
+			return;
+
+		warning("%s: Board counters lost, restore last known position", name);
+		conn.set_cur_position(new CurPosition.with_data(calib.azimuth_position, calib.elevation_position));
+	}
+
+	/**
+	 * Save state, if force is false not faster than CALIB_SAVE_PERIOD_US
+	 */
+	private void save_calibration(bool force) {
+		if (calib_store == null)
+			return;
+
+		var now = get_monotonic_time();
+		if (!force && now - calib_save_time < CALIB_SAVE_PERIOD_US)
+			return;
+
+		calib.homed = homed;
+		calib_store.store(name, calib);
+		calib_save_time = now;
+	}
+
+	// -*- homing process -*-
+
+	/**
+	 * Waits status which reflects all commands up to seq.
+	 *
+	 * Woken by handle_status() or homing cancel,
+	 * so no handlers are connected per wait.
+	 *
+	 * @return false if homing cancelled
+	 */
+	private async bool wait_status(uint32 seq, out StatusData status) {
+		status = {};
+		if (homing_cancelable.is_cancelled())
+			return false;
+
+		status_wait_seq = seq;
+		status_waiter = wait_status.callback;
+		yield;
+
+		status = waited_status;
+		return !homing_cancelable.is_cancelled();
+	}
+
+	private void wake_status_waiter() {
+		if (status_waiter == null)
+			return;
+
+		SourceFunc cb = (owned) status_waiter;
+		status_waiter = null;
+		cb();
+	}
+
+	/**
+	 * Send homing move, homing_finish() waits status after the last one
+	 */
+	private uint32 homing_move(int32 az, int32 el) {
+		homing_seq = worker.send_az_el(az, el);
+		return homing_seq;
+	}
+
+	// Stop and reset position to 0
+	private async void homing_init() {
+		assert(!homing_cancelable.is_cancelled());
+
+		debug("%s: Homing init begins", name);
+
+		// send stop
+		var seq = worker.send_stop(true, true);
+		homing_seq = seq;
+
+		// wait while it stops
+		StatusData s;
+		var stopped = yield wait_stopped(seq, out s);
+		if (stopped) {
+			debug("%s: Reset current position to 0", name);
+			worker.set_cur_position(0, 0);
+
+			message("%s: Apply homing settings", name);
+			worker.set_stepper_settings(homing_settings);
+		}
+
+		// we are done or cancelled
+		debug("%s: Homing init %s", name, homing_cancelable.is_cancelled()? "canceled" : "done");
+	}
+
+	// Do homing
+	private async void homing_homing() {
+		if (homing_cancelable.is_cancelled())
+			return;
+
+		debug("%s: Homing process begins", name);
+
+		bool az_in_home = false;
+		bool el_in_home = false;
+		int az_n = 1;
+		int el_n = 1;
+		int32 az_pos = 0;
+		int32 el_pos = 0;
+		uint32 seq = 0;
+
+		while (!(az_in_home && el_in_home)) {
+			StatusData s;
+			var ok = yield wait_status(seq, out s);
+			if (!ok)
+				break;
+
+			// latch home positions
+			if (s.az_endstop() && !az_in_home) {
+				az_in_home = true;
+				az_pos = s.azimuth_position;
+			}
+			if (s.el_endstop() && !el_in_home) {
+				el_in_home = true;
+				el_pos = s.elevation_position;
+			}
+
+			// next move
+			if (!s.az_in_motion() && !az_in_home) {
+				double ang = az_n * Math.PI;
+				if ((az_n % 2) != 0) ang = -ang;
+				az_n++;
+
+				// limit to one shaft revolution
+				if (Math.fabs(ang) > 2 * Math.PI) {
+					ang = (ang < 0)? -2 * Math.PI : 2 * Math.PI;
+					warning(@"$name: Homing: reach azimuth angle limit! n: $az_n");
+				}
+
+				az_pos = az_mc.to_steps((float) ang);
+			}
+			if (!s.el_in_motion() && !el_in_home) {
+				double ang = el_n * Math.PI;
+				if ((el_n % 2) != 0) ang = -ang;
+				el_n++;
+
+				// limit to one shaft revolution
+				if (Math.fabs(ang) > 2 * Math.PI) {
+					ang = (ang < 0)? -2 * Math.PI : 2 * Math.PI;
+					warning(@"$name: Homing: reach elevation angle limit! n: $el_n");
+				}
+
+				el_pos = el_mc.to_steps((float) ang);
+			}
+
+			// apply positions
+			seq = homing_move(az_pos, el_pos);
+		}
+
+		// we are done or cancelled
+		if (homing_cancelable.is_cancelled())
+			worker.send_stop(true, true);
+
+		debug("%s: Homing process %s", name, homing_cancelable.is_cancelled()? "canceled" : "done");
+	}
+
+	/**
+	 * Waits latched endstop edges.
+	 *
+	 * @return latch or null if homing cancelled
+	 */
+	private async EndstopLatchData? wait_endstop_latch() {
+		if (homing_cancelable.is_cancelled())
+			return null;
+
+		EndstopLatchData? result = null;
+		var seq = worker.read_endstop_latch();
+
+		var cancel = homing_cancelable.cancelled.connect(
+				() => wait_endstop_latch.callback());
+		var handler = worker.endstop_latch_received.connect((l, l_seq) => {
+				if (l_seq == seq) {
+					result = l;
+					wait_endstop_latch.callback();
+				}
+			});
+		yield;
+
+		homing_cancelable.disconnect(cancel);
+		SignalHandler.disconnect(worker, handler);
+		return result;
+	}
+
+	/**
+	 * Move both axes through targets until endstop edges found.
+	 *
+	 * Axis goes to next target when previous reached without edge.
+	 * Found axis returns to its edge position.
+	 *
+	 * Edge captured from first status with endstop set: with status stream
+	 * it is sent on change, so at the edge; with firmware latch
+	 * exact edge position replaces it.
+	 *
+	 * @return false if cancelled or edge not found
+	 */
+	private async bool seek_edges(int32[] az_targets, int32[] el_targets,
+			out int32 az_edge, out int32 el_edge) {
+		bool az_found = false;
+		bool el_found = false;
+		int az_i = 0;
+		int el_i = 0;
+
+		az_edge = 0;
+		el_edge = 0;
+
+		if (endstop_latch)
+			worker.arm_endstop_latch();
+
+		var az_pos = az_targets[az_i++];
+		var el_pos = el_targets[el_i++];
+		var seq = homing_move(az_pos, el_pos);
+
+		while (!(az_found && el_found)) {
+			StatusData s;
+			var ok = yield wait_status(seq, out s);
+			if (!ok)
+				return false;
+
+			var changed = false;
+
+			// capture edges
+			if (s.az_endstop() && !az_found) {
+				az_found = true;
+				az_edge = s.azimuth_position;
+				az_pos = az_edge;
+				changed = true;
+			}
+			if (s.el_endstop() && !el_found) {
+				el_found = true;
+				el_edge = s.elevation_position;
+				el_pos = el_edge;
+				changed = true;
+			}
+
+			// next move
+			if (!s.az_in_motion() && !az_found) {
+				if (az_i >= az_targets.length) {
+					warning("%s: Homing: azimuth endstop not found", name);
+					return false;
+				}
+				az_pos = az_targets[az_i++];
+				changed = true;
+			}
+			if (!s.el_in_motion() && !el_found) {
+				if (el_i >= el_targets.length) {
+					warning("%s: Homing: elevation endstop not found", name);
+					return false;
+				}
+				el_pos = el_targets[el_i++];
+				changed = true;
+			}
+
+			if (changed)
+				seq = homing_move(az_pos, el_pos);
+		}
+
+		if (endstop_latch) {
+			var l = yield wait_endstop_latch();
+			if (l == null)
+				return false;
+
+			if (l.az_latched())
+				az_edge = l.azimuth_position;
+			if (l.el_latched())
+				el_edge = l.elevation_position;
+
+			// return to exact edges
+			StatusData st;
+			var stopped = yield wait_stopped(homing_move(az_edge, el_edge), out st);
+			if (!stopped)
+				return false;
+		}
+
+		return true;
+	}
+
+	/**
+	 * Waits until both motors stops
+	 *
+	 * @return false if homing cancelled
+	 */
+	private async bool wait_stopped(uint32 seq, out StatusData status) {
+		do {
+			var ok = yield wait_status(seq, out status);
+			if (!ok)
+				return false;
+		} while (status.az_in_motion() || status.el_in_motion());
+
+		return true;
+	}
+
+	/**
+	 * Angle in steps, always positive
+	 */
+	private static int32 angle_steps(MotConv mc, double angle) {
+		var steps = mc.to_steps((float) angle);
+		return (steps < 0)? -steps : steps;
+	}
+
+	// Fast homing phases, returns false on fail or cancel
+	private async bool homing_fast_phases() {
+		int32 az_edge, el_edge;
+		var az_backoff = angle_steps(az_mc, homing_backoff);
+		var el_backoff = angle_steps(el_mc, homing_backoff);
+
+		// phase 1: same sweep as slow homing, at tracking speed
+		worker.set_stepper_settings(tracking_settings);
+		int32[] az_sweep = {
+			az_mc.to_steps((float) -Math.PI),
+			az_mc.to_steps((float) (2 * Math.PI)),
+			az_mc.to_steps((float) (-2 * Math.PI))
+		};
+		int32[] el_sweep = {
+			el_mc.to_steps((float) -Math.PI),
+			el_mc.to_steps((float) (2 * Math.PI)),
+			el_mc.to_steps((float) (-2 * Math.PI))
+		};
+
+		var found = yield seek_edges(az_sweep, el_sweep, out az_edge, out el_edge);
+		if (!found)
+			return false;
+
+		debug("%s: Coarse edges: AZ %d EL %d", name, az_edge, el_edge);
+
+		// phase 2: back off to negative side and approach slowly
+		worker.set_stepper_settings(homing_settings);
+		var seq = homing_move(az_edge - az_backoff, el_edge - el_backoff);
+		StatusData s;
+		var stopped = yield wait_stopped(seq, out s);
+		if (!stopped)
+			return false;
+		if (s.az_endstop() || s.el_endstop()) {
+			warning("%s: Homing: endstop still active after back off, increase it", name);
+			return false;
+		}
+
+		int32[] az_approach = { az_edge + az_backoff };
+		int32[] el_approach = { el_edge + el_backoff };
+		found = yield seek_edges(az_approach, el_approach, out az_edge, out el_edge);
+		if (!found)
+			return false;
+
+		debug("%s: Fine edges: AZ %d EL %d", name, az_edge, el_edge);
+		return true;
+	}
+
+	// Do two-phase homing
+	private async void homing_fast() {
+		if (homing_cancelable.is_cancelled())
+			return;
+
+		debug("%s: Fast homing begins", name);
+
+		var ok = yield homing_fast_phases();
+		if (!ok) {
+			worker.send_stop(true, true);
+			homing_cancelable.cancel();
+		}
+
+		debug("%s: Fast homing %s", name, ok? "done" : "failed or canceled");
+	}
+
+	// Waits until motors stops and apply home position
+	private async void homing_finish() {
+		if (homing_cancelable.is_cancelled())
+			return;
+
+		debug("%s: Homing finishing", name);
+
+		StatusData s;
+		var stopped = yield wait_stopped(homing_seq, out s);
+		if (stopped) {
+			debug("%s: Reset current position to 0", name);
+			worker.set_cur_position(0, 0);
+		}
+	}
+
+	private async void homing_proc() {
+		message("%s: Homing process started", name);
+		homing_in_proc = true;
+		homed = false;
+		save_calibration(true);
+		worker.clear_goal();
+		worker.status_period_ms = HOMING_PERIOD_MS;
+
+		yield homing_init();
+		if (fast_homing)
+			yield homing_fast();
+		else
+			yield homing_homing();
+		yield homing_finish();
+
+		if (!homing_cancelable.is_cancelled()) {
+			homed = true;
+			calib.azimuth_position = 0;
+			calib.elevation_position = 0;
+			calib.azimuth_goal = 0;
+			calib.elevation_goal = 0;
+			save_calibration(true);
+		}
+
+		message("%s: Apply tracking settings", name);
+		worker.set_stepper_settings(tracking_settings);
+
+		worker.status_period_ms = STATUS_PERIOD_MS;
+		message("%s: Hoiming finished", name);
+		homing_in_proc = false;
+	}
+
+	//! commands @{
+	public void start_homing() {
+		if (!connected) {
+			warning("%s: Requested to start homing process. But device disconnected.", name);
+		} else if (!homing_in_proc) {
+			homing_cancelable.reset();
+			homing_proc.begin();
+		} else {
+			warning("%s: Requested to start homing process. But it already run.", name);
+		}
+	}
+
+	public void cancel_homing() {
+		homing_cancelable.cancel();
+	}
+
+	public void stop_motors() {
+		if (connected)
+			worker.send_stop(true, true);
+	}
+	//! @}
+
+	// -*- subscriber callbacks -*-
+
+	public void handle_joint_goal(xat_msgs.joint_goal_t goal) {
+		var rtime = get_monotonic_time();
+		xat_msgs.LatencyTrace.record("goal_lcm", rtime - xat_msgs.ClockSync.to_local(goal_node, goal.header.stamp));
+
+		if (homing_in_proc) {
+			debug("%s: Homing in process, goal [#%d time: %" + int64.FORMAT + "] is skipped.", name, goal.header.seq, goal.header.stamp);
+			return;
+		}
+
+		var az = az_mc.to_steps(goal.azimuth_angle);
+		var el = el_mc.to_steps(goal.elevation_angle);
+
+		debug("%s: Got goal: #%d time: %" + int64.FORMAT, name, goal.header.seq, goal.header.stamp);
+		debug("\tAZ: %+4.6f rad (%+10d)", goal.azimuth_angle, az);
+		debug("\tEL: %+4.6f rad (%+10d)", goal.elevation_angle, el);
+
+		calib.azimuth_goal = az;
+		calib.elevation_goal = el;
+		goal_valid = true;
+
+		var origin = (goal.origin_stamp != 0)? xat_msgs.ClockSync.to_local(goal_node, goal.origin_stamp) : 0;
+		if (connected)
+			worker.set_goal(az, el, origin);
+	}
+
+	// -*- worker callbacks -*-
+
+	private void handle_goal_written(int64 origin, int64 queued, int64 written) {
+		xat_msgs.LatencyTrace.record("rotd_hid", written - queued);
+		xat_msgs.LatencyTrace.record("total", written - origin);
+	}
+
+	private void handle_status(uint32 cmd_seq) {
+		var status = worker.last_status;
+		unowned xat_msgs.joint_state_t ps = state_msg;
+
+		status_header.fill_now(ps.header);
+		// flags
+		ps.homing_in_proc = homing_in_proc;
+		ps.azimuth_in_motion = status.az_in_motion();
+		ps.elevation_in_motion = status.el_in_motion();
+		ps.azimuth_in_endstop = status.az_endstop();
+		ps.elevation_in_endstop = status.el_endstop();
+		// positions
+		ps.azimuth_step_cnt = status.azimuth_position;
+		ps.elevation_step_cnt = status.elevation_position;
+		ps.azimuth_angle = az_mc.to_rad(status.azimuth_position);
+		ps.elevation_angle = el_mc.to_rad(status.elevation_position);
+		// goal statistics
+		ps.goals_coalesced = worker.goals_coalesced;
+		ps.goals_skipped = worker.goals_skipped;
+		ps.device_stamp = status.device_stamp;
+
+		if (xat_msgs.LocalBus.publish(state_channel, ps)) {
+			if (state_encoder.is_valid)
+				lcm.publish(state_channel, xat_msgs.LocalBus.mirror(state_channel, state_encoder.encode(ps)));
+			else
+				lcm.publish(state_channel, xat_msgs.LocalBus.mirror(state_channel, ps.encode()));
+		}
+
+		// keep last known position
+		if (homed && !homing_in_proc
+				&& (status.azimuth_position != calib.azimuth_position
+					|| status.elevation_position != calib.elevation_position)) {
+			calib.azimuth_position = status.azimuth_position;
+			calib.elevation_position = status.elevation_position;
+			save_calibration(false);
+		}
+
+		// homing process waits this status
+		if (status_waiter != null && (int32) (cmd_seq - status_wait_seq) >= 0) {
+			waited_status = status;
+			wake_status_waiter();
+		}
+	}
+
+	private void handle_bat_voltage(BatVoltageData rv) {
+		var pv = new xat_msgs.voltage_t();
+
+		pv.header = bat_voltage_header.next_now();
+		pv.voltage = rv.battery_voltage();
+
+		lcm.publish(bat_voltage_channel, pv.encode());
+	}
+}
@@ -31,13 +31,12 @@ class MotConv {
 }
 
 class RotD : Object {
-	private static XatHid.HIDConn conn;
+	private static RotDevice[] devices;
+	private static HashTable<string, RotDevice> goal_channels;
 	private static Lcm.LcmNode? lcm;
 	private static MainLoop loop;
-
-	// header data
-	private static xat_msgs.HeaderFiller status_header;
-	private static xat_msgs.HeaderFiller bat_voltage_header;
+	private static CalibStore? calib_store = null;
+	private static HotPlug? hotplug = null;
 
 	// motor settings
 	private static MotConv az_mc;
@@ -48,20 +47,22 @@ class RotD : Object {
 	// lcm polling
 	private static IOChannel lcm_iochannel = null;
 
-	// homing
-	private static Cancellable homing_cancelable;
-	private static bool homing_in_proc;
-
-	// polling rates
-	private const int STATUS_PERIOD_MS = 100;	// -> 10 Hz
-	private const int BAT_VOLTAGE_PERIOD_MS = 1000;	// ->  1 Hz
-	private const int HOMING_PERIOD_MS = 50;	// -> 20 Hz
-
 	// -*- options -*-
 
 	// main opts
 	private static string? lcm_url = null;
 	private static int dev_index = 0;
+	[CCode (array_length = false, array_null_terminated = true)]
+	private static string[]? dev_specs = null;
+	private static int goal_rate = 50;
+	private static int stream_rate = 50;
+	private static bool no_stream = false;
+	private static bool no_telemetry = false;
+	private static string? state_file = null;
+	private static double state_tol = 1.0;
+	private static bool no_reconnect = false;
+	private static bool trace = false;
+	private static string goal_node = "trakd";
 	// azimuth motor opts
 	private static int az_steps_per_rev = 200;
 	private static double az_reduction_ratio = 1.0;
@@ -75,6 +76,8 @@ class RotD : Object {
 	private static int hm_el_acc = 100;
 	private static int hm_az_msp = 200;
 	private static int hm_el_msp = 200;
+	private static bool hm_fast = false;
+	private static double hm_backoff = 10.0;
 	// tracking settings opts
 	private static int tr_az_acc = 200;
 	private static int tr_el_acc = 200;
@@ -84,6 +87,16 @@ class RotD : Object {
 	private const GLib.OptionEntry[] options = {
 		{"lcm-url", 'l', 0, OptionArg.STRING, ref lcm_url, "LCM connection URL", "URL"},
 		{"dev-idx", 'i', 0, OptionArg.INT, ref dev_index, "Device index", "NUM"},
+		{"device", 'd', 0, OptionArg.STRING_ARRAY, ref dev_specs, "Named device by index or serial number (repeat for several boards)", "NAME=#IDX|sn:SERIAL"},
+		{"goal-rate", 0, 0, OptionArg.INT, ref goal_rate, "Maximum goal output rate (0 unlimited)", "HZ"},
+		{"stream-rate", 0, 0, OptionArg.INT, ref stream_rate, "Status stream rate (0 only on change)", "HZ"},
+		{"no-stream", 0, 0, OptionArg.NONE, ref no_stream, "Poll status even if device can stream it", null},
+		{"no-telemetry", 0, 0, OptionArg.NONE, ref no_telemetry, "Use separate status and voltage reports", null},
+		{"state-file", 0, 0, OptionArg.FILENAME, ref state_file, "Keep calibration, resume without homing on restart", "PATH"},
+		{"state-tol", 0, 0, OptionArg.DOUBLE, ref state_tol, "Allowed position mismatch to resume calibration", "DEG"},
+		{"no-reconnect", 0, 0, OptionArg.NONE, ref no_reconnect, "Quit on HID error instead of waiting for device", null},
+		{"trace", 0, 0, OptionArg.NONE, ref trace, "Publish latency statistics", null},
+		{"goal-node", 0, 0, OptionArg.STRING, ref goal_node, "Node name of goal stamps source, for clock offset", "NAME"},
 
 		{"az-steps", 0, 0, OptionArg.INT, ref az_steps_per_rev, "AZ steps per motor shaft revolution", "NUM"},
 		{"az-ratio", 0, 0, OptionArg.DOUBLE, ref az_reduction_ratio, "AZ reduction ratio", "NUM"},
@@ -97,6 +110,8 @@ class RotD : Object {
 		{"hm-el-acc", 0, 0, OptionArg.INT, ref hm_el_acc, "EL accelaration [step/sec2]", "NUM"},
 		{"hm-az-msp", 0, 0, OptionArg.INT, ref hm_az_msp, "AZ maximum speed [step/sec]", "NUM"},
 		{"hm-el-msp", 0, 0, OptionArg.INT, ref hm_el_msp, "EL maximum speed [step/sec]", "NUM"},
+		{"hm-fast", 0, 0, OptionArg.NONE, ref hm_fast, "Two-phase homing: seek at tracking speed, approach at homing speed", null},
+		{"hm-backoff", 0, 0, OptionArg.DOUBLE, ref hm_backoff, "Back off before slow approach", "DEG"},
 
 		{"tr-az-acc", 0, 0, OptionArg.INT, ref tr_az_acc, "AZ accelaration [step/sec2]", "NUM"},
 		{"tr-el-acc", 0, 0, OptionArg.INT, ref tr_el_acc, "EL accelaration [step/sec2]", "NUM"},
@@ -108,7 +123,7 @@ class RotD : Object {
 
 	// -*- helpers -*-
 
-	private static void debug_stepper_settings(StepperSettings ss, string name) {
+	public static void debug_stepper_settings(StepperSettings ss, string name) {
 		debug("%s stepper settings:", name);
 		debug("\tAZ acceleration: %d", ss.azimuth_acceleration);
 		debug("\tEL acceleration: %d", ss.elevation_acceleration);
@@ -116,170 +131,37 @@ class RotD : Object {
 		debug("\tEL max speed:    %d", ss.elevation_max_speed);
 	}
 
-	private static void debug_status(Status s) {
-		debug("Status:");
-		debug(@"\tFlags:   %s%s", s.az_in_motion? "AZ_IN_MOTION " : "", s.el_in_motion? "EL_IN_MOTION" : "");
-		debug(@"\tButtons: %s%s", s.az_endstop? "AZ_ENDSTOP " : "", s.el_endstop? "EL_ENDSTOP" : "");
-		debug(@"\tAZ position: $(s.azimuth_position)");
-		debug(@"\tEL position: $(s.elevation_position)");
-	}
-
-	// -*- homing process -*-
-
-	// Stop and reset position to 0
-	private static async void homing_init() {
-		assert(!homing_cancelable.is_cancelled());
-
-		debug("Homing init begins");
-
-		// setup cancellable to stop polling
-		var cancel = homing_cancelable.cancelled.connect(
-				() => homing_init.callback());
-
-		// send stop
-		conn.send_stop(new Stop.with_data(true, true));
-
-		// wait while it stops
-		var to_src = Timeout.add(HOMING_PERIOD_MS,
-			() => {
-				// XXX error handling
-				var s = conn.get_status();
-				if (s.az_in_motion || s.el_in_motion)
-					return true;
-
-				debug("Reset current position to 0");
-				conn.set_cur_position(new CurPosition.with_data(0, 0));
-
-				message("Apply homing settings");
-				conn.set_stepper_settings(homing_settings);
-
-				homing_init.callback();
-				return false;
-			});
-		yield;
-
-		// we are done or cancelled
-		Source.remove(to_src);
-		homing_cancelable.disconnect(cancel);
-		debug("Homing init %s", homing_cancelable.is_cancelled()? "canceled" : "done");
-	}
-
-	// Do homing
-	private static async void homing_homing() {
-		if (homing_cancelable.is_cancelled())
-			return;
-
-		debug("Homing process begins");
-
-		// setup cancellable to stop
-		var cancel = homing_cancelable.cancelled.connect(
-				() => homing_homing.callback());
-
-		bool az_in_home = false;
-		bool el_in_home = false;
-		int az_n = 1;
-		int el_n = 1;
-		var az_el = new AzEl.with_data(0, 0);
-
-		var to_src = Timeout.add(HOMING_PERIOD_MS,
-			() => {
-				// XXX error handling
-				var s = conn.get_status();
-
-				// latch home positions
-				if (s.az_endstop && !az_in_home) {
-					az_in_home = true;
-					az_el.azimuth_position = s.azimuth_position;
-				}
-				if (s.el_endstop && !el_in_home) {
-					el_in_home = true;
-					az_el.elevation_position = s.elevation_position;
-				}
-
-				// next move
-				if (!s.az_in_motion && !az_in_home) {
-					double ang = az_n * Math.PI;
-					if ((az_n % 2) != 0) ang = -ang;
-					az_n++;
-
-					// limit to one shaft revolution
-					if (Math.fabs(ang) > 2 * Math.PI) {
-						ang = (ang < 0)? -2 * Math.PI : 2 * Math.PI;
-						warning(@"Homing: reach azimuth angle limit! n: $az_n");
-					}
-
-					az_el.azimuth_position = az_mc.to_steps((float) ang);
-				}
-				if (!s.el_in_motion && !el_in_home) {
-					double ang = el_n * Math.PI;
-					if ((el_n % 2) != 0) ang = -ang;
-					el_n++;
-
-					// limit to one shaft revolution
-					if (Math.fabs(ang) > 2 * Math.PI) {
-						ang = (ang < 0)? -2 * Math.PI : 2 * Math.PI;
-						warning(@"Homing: reach elevation angle limit! n: $el_n");
-					}
-
-					az_el.elevation_position = el_mc.to_steps((float) ang);
-				}
-
-				// apply positions
-				conn.send_az_el(az_el);
-
-				// check if we in home then terminame polling
-				if (az_in_home && el_in_home) {
-					homing_homing.callback();
-					return false;
-				} else {
-					return true;
-				}
-			});
-		yield;
-
-		// we are done or cancelled
-		Source.remove(to_src);
-		homing_cancelable.disconnect(cancel);
-
-		if (homing_cancelable.is_cancelled())
-			conn.send_stop(new Stop.with_data(true, true));
-
-		debug("Homing process %s", homing_cancelable.is_cancelled()? "canceled" : "done");
-	}
-
-	// Waits until motors stops and apply home position
-	private static async void homing_finish() {
-		debug("Homing finishing");
-
-		Timeout.add(HOMING_PERIOD_MS,
-			() => {
-				// XXX error handling
-				var s = conn.get_status();
-				if (s.az_in_motion || s.el_in_motion)
-					return true;
-
-				debug("Reset current position to 0");
-				conn.set_cur_position(new CurPosition.with_data(0, 0));
-
-				message("Apply tracking settings");
-				conn.set_stepper_settings(tracking_settings);
-
-				homing_finish.callback();
-				return false;
-			});
-		yield;
-	}
-
-	private static async void homing_proc() {
-		message("Homing process started");
-		homing_in_proc = true;
-
-		yield homing_init();
-		yield homing_homing();
-		yield homing_finish();
+	/**
+	 * Open device and add it to the table
+	 *
+	 * @param name device name, null for legacy single device
+	 * @param spec device spec, see XatHid.HIDConn.open_spec()
+	 */
+	private static void add_device(string? name, string spec) throws Error {
+		if (name != null) {
+			foreach (var d in devices) {
+				if (d.name == name)
+					throw new OptionError.BAD_VALUE(@"duplicate device name: $name");
+			}
+		}
 
-		message("Hoiming finished");
-		homing_in_proc = false;
+		var dev = new RotDevice(name, spec, lcm, az_mc, el_mc, homing_settings, tracking_settings);
+		dev.calib_store = calib_store;
+		dev.calib_tolerance = state_tol * Math.PI / 180.0;
+		dev.fast_homing = hm_fast;
+		dev.homing_backoff = hm_backoff * Math.PI / 180.0;
+		dev.use_stream = !no_stream;
+		dev.stream_rate = stream_rate;
+		dev.use_telemetry = !no_telemetry;
+		dev.goal_rate = goal_rate;
+		dev.reconnect = !no_reconnect;
+		dev.goal_node = goal_node;
+		dev.open();
+		dev.io_error.connect((msg) => handle_io_error(dev.name, msg));
+
+		devices += dev;
+		goal_channels.insert(dev.goal_channel, dev);
+		message("%s: HID ok.", dev.name);
 	}
 
 	// -*- subscriber callbacks -*-
@@ -289,25 +171,21 @@ class RotD : Object {
 
 		switch (cmd.command) {
 		case xat_msgs.command_t.HOMING_START:
-			if (!homing_in_proc) {
-				message("Requested to start homing process.");
-				homing_cancelable.reset();
-				homing_proc.begin();
-			} else {
-				warning("Requested to start homing process. But it already run.");
-			}
+			message("Requested to start homing process.");
+			foreach (var dev in devices)
+				dev.start_homing();
 			break;
 
 		case xat_msgs.command_t.HOMING_CANCEL:
-			// XXX buggy :(
 			message("Requested to cancel homing process.");
-			homing_cancelable.cancel();
+			foreach (var dev in devices)
+				dev.cancel_homing();
 			break;
 
 		case xat_msgs.command_t.MOTOR_STOP:
 			message("Requested to stop motors.");
-			//homing_cancelable.cancel();
-			conn.send_stop(new Stop.with_data(true, true));
+			foreach (var dev in devices)
+				dev.stop_motors();
 			break;
 
 		case xat_msgs.command_t.TERMINATE_ALL:
@@ -320,58 +198,18 @@ class RotD : Object {
 		}
 	}
 
-	private static void handle_joint_goal(xat_msgs.joint_goal_t goal) {
-		if (homing_in_proc) {
-			debug(@"Homing in process, goal [#$(goal.header.seq) time: $(goal.header.stamp)] is skipped.");
-			return;
-		}
-
-		var az_el = new AzEl();
-		az_el.azimuth_position = az_mc.to_steps(goal.azimuth_angle);
-		az_el.elevation_position = el_mc.to_steps(goal.elevation_angle);
-
-		debug(@"Got goal: #$(goal.header.seq) time: $(goal.header.stamp)");
-		debug("\tAZ: %+4.6f rad (%+10d)", goal.azimuth_angle, az_el.azimuth_position);
-		debug("\tEL: %+4.6f rad (%+10d)", goal.elevation_angle, az_el.elevation_position);
-
-		conn.send_az_el(az_el);
-		// todo check send error
-	}
-
-	// -*- timer callbacks -*-
-
-	private static bool timer_publish_status() {
-		var status = conn.get_status();
-		var ps = new xat_msgs.joint_state_t();
-
-		ps.header = status_header.next_now();
-		// flags
-		ps.homing_in_proc = homing_in_proc;
-		ps.azimuth_in_motion = status.az_in_motion;
-		ps.elevation_in_motion = status.el_in_motion;
-		ps.azimuth_in_endstop = status.az_endstop;
-		ps.elevation_in_endstop = status.el_endstop;
-		// positions
-		ps.azimuth_step_cnt = status.azimuth_position;
-		ps.elevation_step_cnt = status.elevation_position;
-		ps.azimuth_angle = az_mc.to_rad(status.azimuth_position);
-		ps.elevation_angle = el_mc.to_rad(status.elevation_position);
-
-		lcm.publish("xat/rot/state", ps.encode());
-		// todo terminate on error
-		return true;
+	/**
+	 * Goals from trakd in the same process (xat-host)
+	 */
+	private static void subscribe_local_goal(RotDevice dev) {
+		xat_msgs.LocalBus.subscribe(dev.goal_channel, (msg) => dev.handle_joint_goal((xat_msgs.joint_goal_t) msg));
 	}
 
-	private static bool timer_publish_bat_voltage() {
-		var rv = conn.get_bat_voltage();
-		var pv = new xat_msgs.voltage_t();
-
-		pv.header = bat_voltage_header.next_now();
-		pv.voltage = rv.battery_voltage;
+	// -*- worker callbacks -*-
 
-		lcm.publish("xat/battery_voltage", pv.encode());
-		// todo terminate on error
-		return true;
+	private static void handle_io_error(string name, string msg) {
+		critical("%s: HID error: %s", name, msg);
+		loop.quit();
 	}
 
 	static construct {
@@ -380,26 +218,18 @@ class RotD : Object {
 		el_mc = new MotConv();
 		homing_settings = new StepperSettings();
 		tracking_settings = new StepperSettings();
-		status_header = new xat_msgs.HeaderFiller();
-		bat_voltage_header = new xat_msgs.HeaderFiller();
-		// homing canceled by default
-		homing_cancelable = new Cancellable();
-		homing_cancelable.cancel();
-		homing_in_proc = false;
-	}
-
-	private static void sighandler(int signum) {
-		// restore original handler
-		Posix.signal(signum, null);
-		loop.quit();
+		devices = {};
+		goal_channels = new HashTable<string, RotDevice>(str_hash, str_equal);
 	}
 
-	public static int main(string[] args) {
-		new RotD();
-
-		// from FSO fraemwork
-		Posix.signal(Posix.SIGINT, sighandler);
-		Posix.signal(Posix.SIGTERM, sighandler);
+	/**
+	 * Parse options and start node on main loop
+	 *
+	 * @param host_loop loop of xat-host, null for own loop
+	 */
+	public static int setup(string[] args, MainLoop? host_loop = null) {
+		if (host_loop != null)
+			loop = host_loop;
 
 		try {
 			var opt_context = new OptionContext("");
@@ -409,6 +239,13 @@ class RotD : Object {
 			opt_context.add_main_entries(options, null);
 			opt_context.parse(ref args);
 
+			if (dev_specs != null) {
+				foreach (var spec in dev_specs) {
+					if (!spec.contains("="))
+						throw new OptionError.BAD_VALUE(@"device should be NAME=#IDX|sn:SERIAL: $spec");
+				}
+			}
+
 			// apply options to motor conversions
 			az_mc.update(az_steps_per_rev, az_reduction_ratio, az_reversed);
 			el_mc.update(el_steps_per_rev, el_reduction_ratio, el_reversed);
@@ -448,42 +285,44 @@ class RotD : Object {
 			message("LCM ok.");
 		}
 
+		if (state_file != null)
+			calib_store = new CalibStore(state_file);
+
+		// open devices, without names use legacy channels
 		try {
-			conn = XatHid.HIDConn.open(dev_index);
-			message("HID ok.");
-		} catch (FileError e) {
-			error("HID error: %s", e.message);
+			if (dev_specs == null) {
+				add_device(null, @"#$dev_index");
+			} else {
+				foreach (var spec in dev_specs) {
+					var kv = spec.split("=", 2);
+					add_device(kv[0], kv[1]);
+				}
+			}
+		} catch (Error e) {
+			error("Device error: %s", e.message);
 			return 1;
 		}
 
-		// get device caps, TODO parse it
-		try {
-			var devinfo = conn.get_info();
-			message("Device caps: %s", devinfo.device_caps_str);
-
-			// stop motors
-			conn.send_stop(new Stop.with_data(true, true));
-
-			// log current status
-			var status = conn.get_status();
-			debug_status(status);
-
-			// get old settings
-			var old_ss = conn.get_stepper_settings();
-			debug_stepper_settings(old_ss, "Old");
-
-			// apply new settings
-			message("Apply tracking settings");
-			conn.set_stepper_settings(tracking_settings);
-
-		} catch (IOChannelError e) {
-			error("Device io error: %s", e.message);
-			return 1;
+		// start I/O threads, spread their polls over status period
+		for (int i = 0; i < devices.length; i++) {
+			devices[i].poll_offset_us = (int64) i * RotDevice.STATUS_PERIOD_MS * 1000 / devices.length;
+			devices[i].start();
 		}
 
-		// start periodic jobs
-		Timeout.add(STATUS_PERIOD_MS, timer_publish_status);
-		Timeout.add(BAT_VOLTAGE_PERIOD_MS, timer_publish_bat_voltage);
+		// reopen boards as soon as they reappear
+		if (!no_reconnect) {
+			try {
+				hotplug = new HotPlug();
+				hotplug.device_added.connect((devnode) => {
+						foreach (var dev in devices) {
+							if (!dev.connected)
+								dev.try_reconnect();
+						}
+					});
+			} catch (IOChannelError e) {
+				warning("udev monitor: %s, reconnect by timer only", e.message);
+			}
+		}
 
 		// setup watch on LCM FD
 		lcm_iochannel = new IOChannel.unix_new(lcm.get_fileno());
@@ -497,6 +336,11 @@ class RotD : Object {
 				return true;
 			});
 
+		// exchange clock offsets with other nodes
+		xat_msgs.ClockSync.start(lcm, "rotd");
+		if (trace)
+			xat_msgs.LatencyTrace.start(lcm, "rotd");
+
 		// subscribe to topics
 		lcm.subscribe("xat/command",
 			(rbuf, channel, ud) => {
@@ -508,24 +352,63 @@ class RotD : Object {
 				}
 			});
 
-		lcm.subscribe("xat/rot/goal",
-			(rbuf, channel, ud) => {
-				try {
-					var msg = new xat_msgs.joint_goal_t.from_rbuf(rbuf);
-					handle_joint_goal(msg);
-				} catch (Lcm.MessageError e) {
-					error("Message error: %s", e.message);
-				}
-			});
+		foreach (var dev in devices) {
+			lcm.subscribe(dev.goal_channel,
+				(rbuf, channel, ud) => {
+					if (xat_msgs.LocalBus.is_echo(channel, rbuf.data))
+						return;
+
+					try {
+						var msg = new xat_msgs.joint_goal_t.from_rbuf(rbuf);
+						var d = goal_channels.lookup(channel);
+						if (d != null)
+							d.handle_joint_goal(msg);
+					} catch (Lcm.MessageError e) {
+						error("Message error: %s", e.message);
+					}
+				});
 
+			subscribe_local_goal(dev);
+		}
 
-		message("rotd started.");
-		loop.run();
+		return 0;
+	}
 
+	/**
+	 * Stop node after main loop quit
+	 */
+	public static void shutdown() {
 		// send stop before quit
-		conn.send_stop(new Stop.with_data(true, true));
+		foreach (var dev in devices)
+			dev.stop();
+		if (calib_store != null)
+			calib_store.flush();
 		HidApi.exit();
+	}
+
+#if !XAT_HOST
+	private static void sighandler(int signum) {
+		// restore original handler
+		Posix.signal(signum, null);
+		loop.quit();
+	}
+
+	public static int main(string[] args) {
+		new RotD();
+
+		// from FSO fraemwork
+		Posix.signal(Posix.SIGINT, sighandler);
+		Posix.signal(Posix.SIGTERM, sighandler);
+
+		var ret = setup(args);
+		if (ret != 0)
+			return ret;
+
+		message("rotd started.");
+		loop.run();
+		shutdown();
 		message("rotd quit");
 		return 0;
 	}
+#endif
 }
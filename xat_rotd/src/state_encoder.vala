@@ -0,0 +1,105 @@
+/**
+ * joint_state_t LCM encoder into preallocated buffer.
+ *
+ * Generated encode() returns new array on each call, and state
+ * is published at status rate, so here it is encoded in place.
+ * Fingerprint is taken from generated encoder and whole output
+ * compared with it once; if message definition changed, is_valid
+ * is false and caller should use generated encode().
+ */
+class JointStateEncoder {
+	// hash, header, 5 booleans, 6 int32/float, device_stamp
+	public const size_t SIZE = 8 + (4 + 8) + 5 * 1 + 6 * 4 + 8;
+
+	private uint8[] buf = new uint8[SIZE];
+
+	public bool is_valid { get; private set; default = false; }
+
+	public JointStateEncoder() {
+		// distinct value in each field, so misplaced field is detected
+		var sample = new xat_msgs.joint_state_t();
+		sample.header = new xat_msgs.header_t();
+		sample.header.seq = 0x01020304;
+		sample.header.stamp = 0x05060708090a0b0c;
+		sample.homing_in_proc = true;
+		sample.azimuth_in_motion = false;
+		sample.elevation_in_motion = true;
+		sample.azimuth_in_endstop = false;
+		sample.elevation_in_endstop = true;
+		sample.azimuth_step_cnt = -123456;
+		sample.elevation_step_cnt = 654321;
+		sample.azimuth_angle = 1.5f;
+		sample.elevation_angle = -0.25f;
+		sample.goals_coalesced = 7;
+		sample.goals_skipped = 11;
+		sample.device_stamp = -2;
+
+		try {
+			var ref_buf = sample.encode();
+			if (ref_buf.length == SIZE) {
+				Memory.copy(buf, ref_buf, 8);
+				encode(sample);
+				is_valid = Memory.cmp(buf, ref_buf, SIZE) == 0;
+			}
+		} catch (Lcm.MessageError e) {
+			warning("joint_state_t sample encode: %s", e.message);
+		}
+
+		if (!is_valid)
+			warning("joint_state_t layout differs, using generated encoder");
+	}
+
+	/**
+	 * Encode message into internal buffer.
+	 *
+	 * @return encoded message, valid until next call
+	 */
+	public unowned uint8[] encode(xat_msgs.joint_state_t msg) {
+		size_t off = 8;	// fingerprint already in place
+
+		put_int32(ref off, msg.header.seq);
+		put_int64(ref off, msg.header.stamp);
+		put_boolean(ref off, msg.homing_in_proc);
+		put_boolean(ref off, msg.azimuth_in_motion);
+		put_boolean(ref off, msg.elevation_in_motion);
+		put_boolean(ref off, msg.azimuth_in_endstop);
+		put_boolean(ref off, msg.elevation_in_endstop);
+		put_int32(ref off, msg.azimuth_step_cnt);
+		put_int32(ref off, msg.elevation_step_cnt);
+		put_float(ref off, msg.azimuth_angle);
+		put_float(ref off, msg.elevation_angle);
+		put_int32(ref off, msg.goals_coalesced);
+		put_int32(ref off, msg.goals_skipped);
+		put_int64(ref off, msg.device_stamp);
+
+		return buf;
+	}
+
+	/**
+	 * LCM wire encoders, big endian
+	 * @{
+	 */
+	private void put_boolean(ref size_t off, bool val) {
+		buf[off] = val? 1 : 0;
+		off += sizeof(uint8);
+	}
+
+	private void put_int32(ref size_t off, int32 val) {
+		var be32 = val.to_big_endian();
+		Memory.copy(&buf[off], &be32, sizeof(int32));
+		off += sizeof(int32);
+	}
+
+	private void put_int64(ref size_t off, int64 val) {
+		var be64 = val.to_big_endian();
+		Memory.copy(&buf[off], &be64, sizeof(int64));
+		off += sizeof(int64);
+	}
+
+	private void put_float(ref size_t off, float val) {
+		int32 bits = 0;
+		Memory.copy(&bits, &val, sizeof(float));
+		put_int32(ref off, bits);
+	}
+	//! @}
+}
@@ -0,0 +1,51 @@
+/**
+ * malloc call counter for allocation tests.
+ *
+ * Overrides libc allocator entry points in test executable,
+ * GLib g_malloc() and g_slice go through them.
+ */
+
+#include <stddef.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile int counting = 0;
+static volatile int count = 0;
+
+static inline void count_call(void)
+{
+	if (counting)
+		__sync_fetch_and_add(&count, 1);
+}
+
+void *malloc(size_t size)
+{
+	count_call();
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	count_call();
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	count_call();
+	return __libc_realloc(ptr, size);
+}
+
+void alloc_count_start(void)
+{
+	count = 0;
+	counting = 1;
+}
+
+int alloc_count_stop(void)
+{
+	counting = 0;
+	return count;
+}
@@ -0,0 +1,103 @@
+/**
+ * Allocation counting test of rotd steady state path.
+ *
+ * Report decode and encode, command queue, goal mailbox,
+ * worker result dispatch and joint state encode
+ * should not allocate after warm up.
+ */
+
+using XatHid;
+using XatHid.Report;
+
+
+[CCode (cname = "alloc_count_start")]
+extern void alloc_count_start();
+[CCode (cname = "alloc_count_stop")]
+extern int alloc_count_stop();
+
+const int WARMUP = 10;
+const int ITERATIONS = 1000;
+
+void test_steady_path() {
+	// az 10000, el -10000, AZ_IN_MOTION
+	uint8[] status_report = { Status.REPORT_ID, 0x01, 0x00, 0x10, 0x27, 0x00, 0x00, 0xf0, 0xd8, 0xff, 0xff };
+	uint8[] stream_report = { StatusStream.REPORT_ID, 0x01, 0x00, 0x10, 0x27, 0x00, 0x00, 0xf0, 0xd8, 0xff, 0xff, 0x40, 0x42, 0x0f, 0x00 };
+	uint8[] telemetry_report = { Telemetry.REPORT_ID, 0x01, 0x00, 0x10, 0x27, 0x00, 0x00, 0xf0, 0xd8, 0xff, 0xff, 0xff, 0x03 };
+	var az_el_buf = new uint8[AzEl.REPORT_SIZE];
+	var stop_buf = new uint8[Stop.REPORT_SIZE];
+
+	var queue = new CommandQueue(8);
+	var worker = new Worker(new HIDConn());
+
+	var encoder = new JointStateEncoder();
+	assert(encoder.is_valid);
+
+	var header = new xat_msgs.HeaderFiller();
+	var msg = new xat_msgs.joint_state_t();
+	msg.header = new xat_msgs.header_t();
+	int received = 0;
+	size_t encoded = 0;
+
+	// same as RotDevice.handle_status()
+	worker.status_received.connect((seq) => {
+			var st = worker.last_status;
+
+			header.fill_now(msg.header);
+			msg.azimuth_in_motion = st.az_in_motion();
+			msg.elevation_in_motion = st.el_in_motion();
+			msg.azimuth_in_endstop = st.az_endstop();
+			msg.elevation_in_endstop = st.el_endstop();
+			msg.azimuth_step_cnt = st.azimuth_position;
+			msg.elevation_step_cnt = st.elevation_position;
+			msg.goals_coalesced = worker.goals_coalesced;
+			msg.device_stamp = st.device_stamp;
+
+			unowned uint8[] buf = encoder.encode(msg);
+			encoded += buf.length;
+			received++;
+		});
+
+	for (int i = 0; i < WARMUP + ITERATIONS; i++) {
+		if (i == WARMUP)
+			alloc_count_start();
+
+		try {
+			StatusData st = {};
+			st.decode(status_report);
+			st.decode_stream(stream_report);
+
+			TelemetryData tm = {};
+			tm.decode(telemetry_report);
+
+			AzElData ae = { i, -i };
+			ae.encode(az_el_buf);
+
+			StopData sd = { (uint8) Stop.Motor.AZ };
+			sd.encode(stop_buf);
+
+			Command cmd;
+			queue.push(Command() { type = CommandType.AZ_EL, azimuth = i, elevation = -i });
+			queue.pop(out cmd);
+
+			worker.set_goal(i, -i, i);
+			worker.post_status(st, (uint32) i);
+			worker.dispatch_results();
+		} catch (ConvertError e) {
+			error("decode: %s", e.message);
+		}
+	}
+
+	var allocs = alloc_count_stop();
+
+	assert_cmpint(received, CompareOperator.EQ, WARMUP + ITERATIONS);
+	assert_cmpuint((uint) encoded, CompareOperator.EQ, (uint) ((WARMUP + ITERATIONS) * JointStateEncoder.SIZE));
+	assert_cmpint(msg.azimuth_step_cnt, CompareOperator.EQ, 10000);
+	assert_cmpint(msg.elevation_step_cnt, CompareOperator.EQ, -10000);
+	assert_cmpint(allocs, CompareOperator.EQ, 0);
+}
+
+int main(string[] args) {
+	Test.init(ref args);
+	Test.add_func("/rotd/alloc/steady_path", test_steady_path);
+	return Test.run();
+}
@@ -0,0 +1,87 @@
+/**
+ * Geo batch kernels throughput compared with scalar functions.
+ *
+ * Usage: xat-trakd-geo-bench [POINTS]
+ */
+
+const int ROUNDS = 5;
+
+const double HOME_LAT = 55.7522;
+const double HOME_LON = 37.6156;
+
+delegate void KernelFunc(double[] lat, double[] lon, double[] result);
+
+void scalar_distance(double[] lat, double[] lon, double[] result) {
+	for (int i = 0; i < lat.length; i++)
+		result[i] = Geo.get_distance(HOME_LAT, HOME_LON, lat[i], lon[i]);
+}
+
+void batch_distance(double[] lat, double[] lon, double[] result) {
+	Geo.get_distance_batch(HOME_LAT, HOME_LON, lat, lon, result);
+}
+
+void scalar_bearing(double[] lat, double[] lon, double[] result) {
+	for (int i = 0; i < lat.length; i++)
+		result[i] = Geo.get_bearing(HOME_LAT, HOME_LON, lat[i], lon[i]);
+}
+
+void batch_bearing(double[] lat, double[] lon, double[] result) {
+	Geo.get_bearing_batch(HOME_LAT, HOME_LON, lat, lon, result);
+}
+
+// longitude offset as angle of about ±10 rad
+void scalar_wrap_pi(double[] lat, double[] lon, double[] result) {
+	for (int i = 0; i < lon.length; i++)
+		result[i] = Geo.wrap_pi((lon[i] - HOME_LON) * 20.0);
+}
+
+void batch_wrap_pi(double[] lat, double[] lon, double[] result) {
+	for (int i = 0; i < lon.length; i++)
+		result[i] = (lon[i] - HOME_LON) * 20.0;
+	Geo.wrap_pi_batch(result);
+}
+
+double measure(string name, double[] lat, double[] lon, KernelFunc func) {
+	var result = new double[lat.length];
+	int64 best = int64.MAX;
+
+	for (int i = 0; i < ROUNDS; i++) {
+		var start = get_monotonic_time();
+		func(lat, lon, result);
+		best = int64.min(best, get_monotonic_time() - start);
+	}
+
+	var mpps = lat.length / (double) int64.max(best, 1);
+	stdout.printf("%-16s %8.2f Mpoints/s  %s us\n", name, mpps, best.to_string());
+	return mpps;
+}
+
+int main(string[] args) {
+	int points = 200000;
+	if (args.length > 1)
+		points = int.parse(args[1]);
+
+	var rnd = new Rand.with_seed(5);
+	var lat = new double[points];
+	var lon = new double[points];
+	for (int i = 0; i < points; i++) {
+		lat[i] = HOME_LAT + rnd.double_range(-0.5, 0.5);
+		lon[i] = HOME_LON + rnd.double_range(-0.5, 0.5);
+	}
+
+	stdout.printf("points: %d, best of %d rounds\n", points, ROUNDS);
+
+	var s = measure("distance", lat, lon, scalar_distance);
+	var b = measure("distance_batch", lat, lon, batch_distance);
+	stdout.printf("speedup: %.1fx\n", b / s);
+
+	s = measure("bearing", lat, lon, scalar_bearing);
+	b = measure("bearing_batch", lat, lon, batch_bearing);
+	stdout.printf("speedup: %.1fx\n", b / s);
+
+	s = measure("wrap_pi", lat, lon, scalar_wrap_pi);
+	b = measure("wrap_pi_batch", lat, lon, batch_wrap_pi);
+	stdout.printf("speedup: %.1fx\n", b / s);
+
+	return 0;
+}
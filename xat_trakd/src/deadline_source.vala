@@ -0,0 +1,29 @@
+/**
+ * One-shot main loop source at absolute monotonic time.
+ *
+ * Re-armed by arm() without creating new source, so a fallback
+ * deadline can follow each event driven goal solve.
+ */
+class DeadlineSource : Source {
+	/**
+	 * Dispatch at monotonic time [us], -1 - disarm
+	 */
+	public void arm(int64 time) {
+		set_ready_time(time);
+	}
+
+	protected override bool prepare(out int timeout) {
+		// ready time handled by main context
+		timeout = -1;
+		return false;
+	}
+
+	protected override bool check() {
+		return false;
+	}
+
+	protected override bool dispatch(SourceFunc? callback) {
+		set_ready_time(-1);
+		return callback();
+	}
+}
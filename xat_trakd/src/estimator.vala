@@ -0,0 +1,157 @@
+/**
+ * MAV position estimator.
+ *
+ * Constant velocity model: last received position is extrapolated
+ * by smoothed velocity over sample age (transport delay + time since receive).
+ */
+class MavEstimator : Object {
+	/**
+	 * Maximum extrapolation time [us], 0 disables estimation
+	 */
+	public int64 max_age_us = 2000000;
+
+	/**
+	 * Velocity smoothing factor (0..1], 1 - no smoothing
+	 */
+	public double vel_alpha = 0.5;
+
+	// last sample
+	private xat_msgs.lla_point_t? last_p = null;
+	private int64 last_stamp = 0;	// source stamp [us]
+	private int64 last_rtime = 0;	// monotonic receive time [us]
+	private int64 last_delay = 0;	// transport delay of last sample [us]
+
+	// smoothed velocity, NED [m/s]
+	private bool vel_valid = false;
+	private double vel_n = 0.0;
+	private double vel_e = 0.0;
+	private double vel_d = 0.0;
+
+	/**
+	 * Course over ground [0..360) deg, NAN if unknown
+	 */
+	public float heading {
+		get {
+			if (!vel_valid)
+				return float.NAN;
+
+			var hdg = Geo.degrees(Math.atan2(vel_e, vel_n));
+			if (hdg < 0.0)
+				hdg += 360.0;
+
+			return (float) hdg;
+		}
+	}
+
+	/**
+	 * Ground speed [m/s], NAN if unknown
+	 */
+	public float ground_speed {
+		get {
+			if (!vel_valid)
+				return float.NAN;
+
+			return (float) Math.sqrt(vel_n * vel_n + vel_e * vel_e);
+		}
+	}
+
+	public void reset() {
+		last_p = null;
+		vel_valid = false;
+		vel_n = 0.0;
+		vel_e = 0.0;
+		vel_d = 0.0;
+	}
+
+	/**
+	 * Feed new position sample.
+	 *
+	 * If velocity is unknown (NAN) it is derived from previous sample.
+	 *
+	 * @param p     MAV position
+	 * @param stamp sample time, or header stamp if unknown [us]
+	 * @param rtime monotonic receive time [us]
+	 * @param vn    north velocity [m/s]
+	 * @param ve    east velocity [m/s]
+	 * @param vd    down velocity [m/s]
+	 */
+	public void update(xat_msgs.lla_point_t p, int64 stamp, int64 rtime,
+			double vn = double.NAN, double ve = double.NAN, double vd = double.NAN) {
+		// duplicate or reordered sample
+		if (last_p != null && stamp <= last_stamp)
+			return;
+
+		// derive velocity from positions
+		if (!vn.is_finite() || !ve.is_finite()) {
+			if (last_p == null || stamp - last_stamp > max_age_us) {
+				vn = double.NAN;
+				ve = double.NAN;
+			} else {
+				double dn, de, dd;
+				var dt = (stamp - last_stamp) / 1E6;
+
+				Geo.get_ned_offset(last_p.latitude, last_p.longitude, last_p.altitude,
+						p.latitude, p.longitude, p.altitude,
+						out dn, out de, out dd);
+
+				vn = dn / dt;
+				ve = de / dt;
+				vd = dd / dt;
+			}
+		}
+
+		if (!vd.is_finite())
+			vd = 0.0;
+
+		if (vn.is_finite() && ve.is_finite()) {
+			if (!vel_valid) {
+				vel_n = vn;
+				vel_e = ve;
+				vel_d = vd;
+				vel_valid = true;
+			} else {
+				vel_n += vel_alpha * (vn - vel_n);
+				vel_e += vel_alpha * (ve - vel_e);
+				vel_d += vel_alpha * (vd - vel_d);
+			}
+		}
+
+		// transport delay, stamp already converted to local monotonic clock
+		last_delay = xat_msgs.HeaderFiller.now() - stamp;
+		if (last_delay < 0 || last_delay > max_age_us)
+			last_delay = 0;
+
+		last_p = p;
+		last_stamp = stamp;
+		last_rtime = rtime;
+	}
+
+	/**
+	 * Returns estimated position at monotonic time.
+	 */
+	public xat_msgs.lla_point_t? estimate(int64 now) {
+		if (last_p == null)
+			return null;
+
+		var age = last_delay + (now - last_rtime);
+		if (!vel_valid || age <= 0 || max_age_us <= 0)
+			return last_p;
+
+		if (age > max_age_us)
+			age = max_age_us;
+
+		var dt = age / 1E6;
+		double lat = last_p.latitude;
+		double lon = last_p.longitude;
+		double alt = last_p.altitude;
+
+		Geo.add_ned_offset(ref lat, ref lon, ref alt,
+				vel_n * dt, vel_e * dt, vel_d * dt);
+
+		var est_p = new xat_msgs.lla_point_t();
+		est_p.latitude = lat;
+		est_p.longitude = lon;
+		est_p.altitude = (float) alt;
+		return est_p;
+	}
+}
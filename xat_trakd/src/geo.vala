@@ -83,4 +83,233 @@ namespace Geo {
 
 		return wrap_pi(theta);
 	}
+
+	/**
+	 * Batch variants for log analysis, replay and multi vehicle tracking.
+	 *
+	 * Points passed as structure of arrays, home point terms calculated once.
+	 * Loop bodies have no branches (no while/fmod wrapping) and iterations
+	 * are independent, so C compiler may vectorize them
+	 * (-O3, sin/cos/atan2 vector variants need libmvec).
+	 *
+	 * Tolerance against scalar functions, checked by test/geo_test.vala:
+	 * distance 1e-9 relative, angles 1e-9 rad (modulo 2 pi: ±pi may
+	 * come out as either end).
+	 * @{
+	 */
+
+	private const double TWO_PI = 2.0 * Math.PI;
+
+	/**
+	 * Wrap angles to ±pi in place.
+	 *
+	 * Unlike wrap_pi() also wraps angles beyond ±6 pi.
+	 */
+	public void wrap_pi_batch(double[] angles) {
+		for (int i = 0; i < angles.length; i++) {
+			var a = angles[i];
+			angles[i] = a - TWO_PI * Math.floor((a + Math.PI) / TWO_PI);
+		}
+	}
+
+	/**
+	 * Returns distances from coords 1 to each of coords 2.
+	 *
+	 * @param lat1     current position in degrees
+	 * @param lat2     mav positions
+	 * @param distance result array, same length as lat2
+	 */
+	public void get_distance_batch(double lat1, double lon1, double[] lat2, double[] lon2, double[] distance)
+		requires(lat2.length == lon2.length)
+		requires(distance.length >= lat2.length)
+	{
+		var lat1_rad = radians(lat1);
+		var lon1_rad = radians(lon1);
+		var cos_lat1 = Math.cos(lat1_rad);
+
+		for (int i = 0; i < lat2.length; i++) {
+			var lat2_rad = radians(lat2[i]);
+			var lon2_rad = radians(lon2[i]);
+
+			var d_lat_2_sin = Math.sin((lat2_rad - lat1_rad) / 2.0);
+			var d_lon_2_sin = Math.sin((lon2_rad - lon1_rad) / 2.0);
+			var a = d_lat_2_sin * d_lat_2_sin + d_lon_2_sin * d_lon_2_sin * cos_lat1 * Math.cos(lat2_rad);
+
+			distance[i] = RADIUS_OF_EARTH * 2.0 * Math.atan2(Math.sqrt(a), Math.sqrt(1.0 - a));
+		}
+	}
+
+	/**
+	 * Returns bearings from coords 1 to each of coords 2.
+	 *
+	 * atan2() result is already in ±pi, so no wrapping needed.
+	 *
+	 * @param lat1    current position in degrees
+	 * @param lat2    mav positions
+	 * @param bearing result array, same length as lat2
+	 */
+	public void get_bearing_batch(double lat1, double lon1, double[] lat2, double[] lon2, double[] bearing)
+		requires(lat2.length == lon2.length)
+		requires(bearing.length >= lat2.length)
+	{
+		var lat1_rad = radians(lat1);
+		var lon1_rad = radians(lon1);
+		var sin_lat1 = Math.sin(lat1_rad);
+		var cos_lat1 = Math.cos(lat1_rad);
+
+		for (int i = 0; i < lat2.length; i++) {
+			var lat2_rad = radians(lat2[i]);
+			var cos_lat2 = Math.cos(lat2_rad);
+			var d_lon = radians(lon2[i]) - lon1_rad;
+
+			bearing[i] = Math.atan2(Math.sin(d_lon) * cos_lat2,
+					cos_lat1 * Math.sin(lat2_rad) - sin_lat1 * cos_lat2 * Math.cos(d_lon));
+		}
+	}
+	//! @}
+
+	/**
+	 * Move point by NED offset.
+	 *
+	 * Flat earth approximation, good enough for short offsets
+	 * (based on ArduPilot location_offset()).
+	 *
+	 * @param lat latitude in degrees, updated
+	 * @param lon longitude in degrees, updated
+	 * @param alt altitude in meters, updated
+	 * @param north offset to north [m]
+	 * @param east  offset to east [m]
+	 * @param down  offset to down [m]
+	 */
+	public void add_ned_offset(ref double lat, ref double lon, ref double alt,
+			double north, double east, double down) {
+		var d_lat = north / RADIUS_OF_EARTH;
+		var d_lon = east / (RADIUS_OF_EARTH * Math.cos(radians(lat)));
+
+		lat += degrees(d_lat);
+		lon += degrees(d_lon);
+		alt -= down;
+	}
+
+	/**
+	 * Returns NED offset between two coords.
+	 *
+	 * Inverse of add_ned_offset(), flat earth approximation.
+	 */
+	public void get_ned_offset(double lat1, double lon1, double alt1,
+			double lat2, double lon2, double alt2,
+			out double north, out double east, out double down) {
+		north = radians(lat2 - lat1) * RADIUS_OF_EARTH;
+		east = radians(lon2 - lon1) * RADIUS_OF_EARTH * Math.cos(radians(lat1));
+		down = alt1 - alt2;
+	}
+
+	/**
+	 * WGS84 ellipsoid
+	 */
+	public const double WGS84_A = 6378137.0;		// semi-major axis [m]
+	public const double WGS84_E2 = 6.69437999014e-3;	// first eccentricity squared
+
+	/**
+	 * Converts geodetic coords to ECEF.
+	 */
+	public void lla_to_ecef(double lat, double lon, double alt,
+			out double x, out double y, out double z) {
+		var lat_rad = radians(lat);
+		var lon_rad = radians(lon);
+		var sin_lat = Math.sin(lat_rad);
+		var cos_lat = Math.cos(lat_rad);
+
+		var n = WGS84_A / Math.sqrt(1.0 - WGS84_E2 * sin_lat * sin_lat);
+
+		x = (n + alt) * cos_lat * Math.cos(lon_rad);
+		y = (n + alt) * cos_lat * Math.sin(lon_rad);
+		z = (n * (1.0 - WGS84_E2) + alt) * sin_lat;
+	}
+
+	/**
+	 * Local tangent plane (ENU) with cached origin.
+	 *
+	 * Origin ECEF position and rotation are computed once in set_origin(),
+	 * so each conversion costs one lla_to_ecef() and a rotation.
+	 * Unlike great circle distance it accounts Earth curvature in elevation.
+	 */
+	public class LocalFrame {
+		private double origin_lat = double.NAN;
+		private double origin_lon = double.NAN;
+		private double origin_alt = double.NAN;
+
+		// origin ECEF
+		private double ox;
+		private double oy;
+		private double oz;
+
+		// ECEF -> ENU rotation
+		private double sin_lat;
+		private double cos_lat;
+		private double sin_lon;
+		private double cos_lon;
+
+		public bool is_valid {
+			get { return origin_lat.is_finite(); }
+		}
+
+		/**
+		 * Set origin (home), recalculates only if it changed.
+		 */
+		public void set_origin(double lat, double lon, double alt) {
+			if (lat == origin_lat && lon == origin_lon && alt == origin_alt)
+				return;
+
+			origin_lat = lat;
+			origin_lon = lon;
+			origin_alt = alt;
+
+			lla_to_ecef(lat, lon, alt, out ox, out oy, out oz);
+
+			var lat_rad = radians(lat);
+			var lon_rad = radians(lon);
+			sin_lat = Math.sin(lat_rad);
+			cos_lat = Math.cos(lat_rad);
+			sin_lon = Math.sin(lon_rad);
+			cos_lon = Math.cos(lon_rad);
+		}
+
+		/**
+		 * Converts point to ENU relative to origin.
+		 */
+		public void to_enu(double lat, double lon, double alt,
+				out double east, out double north, out double up) {
+			double x, y, z;
+			lla_to_ecef(lat, lon, alt, out x, out y, out z);
+
+			var dx = x - ox;
+			var dy = y - oy;
+			var dz = z - oz;
+
+			east = -sin_lon * dx + cos_lon * dy;
+			north = -sin_lat * cos_lon * dx - sin_lat * sin_lon * dy + cos_lat * dz;
+			up = cos_lat * cos_lon * dx + cos_lat * sin_lon * dy + sin_lat * dz;
+		}
+
+		/**
+		 * Returns look angles to point.
+		 *
+		 * @param azimuth   bearing ±pi [rad]
+		 * @param elevation [rad]
+		 * @param distance  horizontal (tangent plane) distance [m]
+		 * @param range     slant range [m]
+		 */
+		public void get_look_angles(double lat, double lon, double alt,
+				out double azimuth, out double elevation,
+				out double distance, out double range) {
+			double e, n, u;
+			to_enu(lat, lon, alt, out e, out n, out u);
+
+			distance = Math.sqrt(e * e + n * n);
+			range = Math.sqrt(distance * distance + u * u);
+			azimuth = Math.atan2(e, n);
+			elevation = Math.atan2(u, distance);
+		}
+	}
 }
@@ -0,0 +1,106 @@
+/**
+ * Joint goal filter.
+ *
+ * Unwraps azimuth to continuous (multi-turn) angle choosing the shortest slew,
+ * optionally limited by cable wrap, and suppresses goals whose change
+ * is less than one motor step.
+ */
+class GoalFilter : Object {
+	/**
+	 * Azimuth cable limit [rad], goal stays in ±limit. 0 - unlimited.
+	 */
+	public double az_limit = 0.0;
+
+	/**
+	 * Minimal goal change (one motor step) [rad]
+	 */
+	public double az_step = 0.0;
+	public double el_step = 0.0;
+
+	/**
+	 * Republish unchanged goal after this period [us]
+	 */
+	public int64 keepalive_us = 1000000;
+
+	private bool last_valid = false;
+	private double last_az = 0.0;
+	private double last_el = 0.0;
+	private int64 last_time = 0;
+
+	/**
+	 * Returns output shaft step angle
+	 *
+	 * Same conversion as rotd MotConv.
+	 */
+	public static double step_angle(int steps_per_rev, double reduction_ratio)
+		requires(steps_per_rev > 0)
+		requires(reduction_ratio > 0.0)
+	{
+		return (2 * Math.PI / steps_per_rev) / reduction_ratio;
+	}
+
+	public void reset() {
+		last_valid = false;
+	}
+
+	/**
+	 * Unwrap azimuth relative to last goal.
+	 *
+	 * @param azimuth wrapped angle ±pi
+	 * @return continuous angle
+	 */
+	public double unwrap_azimuth(double azimuth) {
+		if (!last_valid)
+			return limit_azimuth(Geo.wrap_pi(azimuth), 0.0);
+
+		var az = last_az + Geo.wrap_pi(azimuth - last_az);
+		return limit_azimuth(az, last_az);
+	}
+
+	private double limit_azimuth(double az, double from) {
+		if (az_limit <= 0.0)
+			return az;
+
+		// shortest way hits the limit, go other way around
+		if (az > az_limit)
+			az -= 2 * Math.PI;
+		else if (az < -az_limit)
+			az += 2 * Math.PI;
+
+		// uncovered sector (limit < pi)
+		if (az > az_limit || az < -az_limit) {
+			var near = (from > 0.0)? az_limit : -az_limit;
+			az = near;
+		}
+
+		return az;
+	}
+
+	/**
+	 * Process new goal.
+	 *
+	 * @param azimuth   wrapped bearing [rad]
+	 * @param elevation [rad]
+	 * @param now       monotonic time [us]
+	 * @param az_out    unwrapped azimuth
+	 * @return true if goal should be published
+	 */
+	public bool update(double azimuth, double elevation, int64 now, out double az_out) {
+		az_out = unwrap_azimuth(azimuth);
+
+		if (last_valid
+				&& Math.fabs(az_out - last_az) < az_step
+				&& Math.fabs(elevation - last_el) < el_step
+				&& (now - last_time) < keepalive_us) {
+			// below one step, keep previous goal
+			az_out = last_az;
+			return false;
+		}
+
+		last_valid = true;
+		last_az = az_out;
+		last_el = elevation;
+		last_time = now;
+		return true;
+	}
+}
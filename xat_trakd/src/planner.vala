@@ -0,0 +1,127 @@
+/**
+ * Slew planner.
+ *
+ * Estimates time needed by steppers to reach the goal, using joint state
+ * feedback and the same trapezoidal profile (acceleration, max speed)
+ * which ROT firmware applies. Goal solver uses this time to aim
+ * at the predicted MAV direction at the moment the mount gets there.
+ */
+class SlewPlanner : Object {
+	/**
+	 * Joint dynamics, [rad/s2] and [rad/s]
+	 */
+	public struct Axis {
+		public double acceleration;
+		public double max_speed;
+
+		// feedback
+		public double position;
+		public double velocity;
+	}
+
+	public Axis az;
+	public Axis el;
+
+	/**
+	 * Maximum lead time [us]
+	 */
+	public int64 max_lead_us = 1000000;
+
+	/**
+	 * State older than this is not used [us]
+	 */
+	public int64 state_timeout_us = 500000;
+
+	private int64 state_rtime = 0;
+	private bool state_valid = false;
+
+	/**
+	 * Set dynamics from stepper settings
+	 *
+	 * @param acc       [step/s2]
+	 * @param max_speed [step/s]
+	 * @param step      step angle [rad]
+	 */
+	public static void setup_axis(ref Axis axis, int acc, int max_speed, double step) {
+		axis.acceleration = acc * step;
+		axis.max_speed = max_speed * step;
+	}
+
+	/**
+	 * Feed joint state from rotd
+	 */
+	public void update_state(xat_msgs.joint_state_t st, int64 rtime) {
+		if (state_valid && rtime > state_rtime) {
+			var dt = (rtime - state_rtime) / 1E6;
+
+			az.velocity = (st.azimuth_in_motion)? (st.azimuth_angle - az.position) / dt : 0.0;
+			el.velocity = (st.elevation_in_motion)? (st.elevation_angle - el.position) / dt : 0.0;
+		} else {
+			az.velocity = 0.0;
+			el.velocity = 0.0;
+		}
+
+		az.position = st.azimuth_angle;
+		el.position = st.elevation_angle;
+		state_rtime = rtime;
+		// homing changes position reference
+		state_valid = !st.homing_in_proc;
+	}
+
+	public bool is_valid(int64 now) {
+		return state_valid && (now - state_rtime) <= state_timeout_us;
+	}
+
+	/**
+	 * Time to move joint to goal and stop there [s]
+	 *
+	 * Trapezoidal velocity profile with initial velocity.
+	 */
+	public static double time_to_reach(Axis axis, double goal) {
+		var d = goal - axis.position;
+		var a = axis.acceleration;
+		var vmax = axis.max_speed;
+
+		if (a <= 0.0 || vmax <= 0.0)
+			return 0.0;
+
+		// velocity along move direction
+		var v0 = (d >= 0.0)? axis.velocity : -axis.velocity;
+		d = Math.fabs(d);
+
+		var t = 0.0;
+		if (v0 < 0.0) {
+			// moving away: stop first
+			t = -v0 / a;
+			d += v0 * v0 / (2 * a);
+			v0 = 0.0;
+		}
+
+		v0 = double.min(v0, vmax);
+		var d_acc = (vmax * vmax - v0 * v0) / (2 * a);
+		var d_dec = vmax * vmax / (2 * a);
+
+		if (d >= d_acc + d_dec) {
+			// reach max speed
+			t += (vmax - v0) / a + vmax / a + (d - d_acc - d_dec) / vmax;
+		} else {
+			// triangle profile with peak speed vp
+			var vp = Math.sqrt((2 * a * d + v0 * v0) / 2);
+			if (vp < v0)
+				vp = v0;	// overshoot, just decelerate
+			t += (vp - v0) / a + vp / a;
+		}
+
+		return t;
+	}
+
+	/**
+	 * Returns lead time for goal [us]
+	 */
+	public int64 lead_time(double az_goal, double el_goal) {
+		var t = double.max(time_to_reach(az, az_goal), time_to_reach(el, el_goal));
+		var lead = (int64) (t * 1E6);
+
+		return (lead > max_lead_us)? max_lead_us : lead;
+	}
+}
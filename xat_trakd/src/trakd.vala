@@ -14,41 +14,95 @@ class TrakD : Object {
 
 	// subscribed topic data
 	private static xat_msgs.gps_fix_t? home_fix;
-	private static xat_msgs.gps_fix_t? mav_fix;
-	private static int64 mav_fix_rtime = 0;
-	private static xat_msgs.global_position_t? mav_global_position;
-	private static int64 mav_global_position_rtime = 0;
-	private static int64 mav_heartbeat_rtime = 0;
+	private static VehicleTable vehicles;
+
+	// goal solver scheduling
+	private static uint solver_src = 0;
+	private static DeadlineSource fallback_src;
+	private static int64 last_solve_time = 0;
+	private static int64 min_solve_interval_us;
+	private static int64 max_solve_interval_us;
+
+	// home centered local tangent plane
+	private static Geo.LocalFrame home_frame;
+
+	// goal publishing
+	private static GoalFilter goal_filter;
+
+	// lead compensation
+	private static SlewPlanner planner;
+	private const int LEAD_ITERATIONS = 3;
 
 	// main options
 	private static string? lcm_url = null;
+	private static string? rot_name = null;
+	private static string rot_goal_channel = "xat/rot/goal";
+	private static string rot_state_channel = "xat/rot/state";
 	private static double _home_lat = 0.0;
 	private static double _home_lon = 0.0;
 	private static double _home_alt = 0.0;
 	private static xat_msgs.lla_point_t def_home_p;
 	private static int _mav_timeout_ms = 5000;
+	private static string mav_node = "mavlinkd";
+	private static bool trace = false;
 	private static int64 mav_timeout_us;
 	private static bool publish_nav_data = false;
+	private static int _est_max_age_ms = 2000;
+	private static bool event_driven = false;
+	private static int _min_rate = 10;
+	private static int _max_rate = 50;
+	// goal filter opts, same motor options as rotd
+	private static double _az_limit = 0.0;
+	private static int az_steps_per_rev = 200;
+	private static double az_reduction_ratio = 1.0;
+	private static int el_steps_per_rev = 200;
+	private static double el_reduction_ratio = 1.0;
+	// slew planner opts, same as rotd tracking settings
+	private static bool lead_enabled = false;
+	private static int _max_lead_ms = 1000;
+	private static int tr_az_acc = 200;
+	private static int tr_el_acc = 200;
+	private static int tr_az_msp = 200;
+	private static int tr_el_msp = 200;
+	// target selection opts
+	private static int target_sysid = -1;
+	private static string? _select_policy = null;
+	private static int _select_margin_ms = 500;
+	private static int _select_dwell_ms = 2000;
 
 	private const GLib.OptionEntry[] options = {
 		{"lcm-url", 'l', 0, OptionArg.STRING, ref lcm_url, "LCM connection", "URL"},
+		{"rot", 'r', 0, OptionArg.STRING, ref rot_name, "Named rotd device to drive", "NAME"},
 		{"hm-lat", 0, 0, OptionArg.DOUBLE, ref _home_lat, "Home latitude", "DEG"},
 		{"hm-lon", 0, 0, OptionArg.DOUBLE, ref _home_lon, "Home longitude", "DEG"},
 		{"hm-alt", 0, 0, OptionArg.DOUBLE, ref _home_alt, "Home altitude", "M"},
 		{"mav-to", 0, 0, OptionArg.INT, ref _mav_timeout_ms, "MAV timeout", "MS"},
+		{"mav-node", 0, 0, OptionArg.STRING, ref mav_node, "Node name of MAV stamps source, for clock offset", "NAME"},
+		{"trace", 0, 0, OptionArg.NONE, ref trace, "Publish latency statistics", null},
+		{"est-max-age", 0, 0, OptionArg.INT, ref _est_max_age_ms, "Maximum position extrapolation time (0 disables)", "MS"},
+		{"event", 'e', 0, OptionArg.NONE, ref event_driven, "Solve goal on MAV message arrival", null},
+		{"min-rate", 0, 0, OptionArg.INT, ref _min_rate, "Minimum (timer) goal rate", "HZ"},
+		{"max-rate", 0, 0, OptionArg.INT, ref _max_rate, "Maximum goal rate in event mode", "HZ"},
+		{"az-limit", 0, 0, OptionArg.DOUBLE, ref _az_limit, "AZ cable limit, ±DEG from home (0 unlimited)", "DEG"},
+		{"az-steps", 0, 0, OptionArg.INT, ref az_steps_per_rev, "AZ steps per motor shaft revolution", "NUM"},
+		{"az-ratio", 0, 0, OptionArg.DOUBLE, ref az_reduction_ratio, "AZ reduction ratio", "NUM"},
+		{"el-steps", 0, 0, OptionArg.INT, ref el_steps_per_rev, "EL steps per motor shaft revolution", "NUM"},
+		{"el-ratio", 0, 0, OptionArg.DOUBLE, ref el_reduction_ratio, "EL reduction ratio", "NUM"},
+		{"lead", 0, 0, OptionArg.NONE, ref lead_enabled, "Compensate slew time using joint state feedback", null},
+		{"max-lead", 0, 0, OptionArg.INT, ref _max_lead_ms, "Maximum lead time", "MS"},
+		{"tr-az-acc", 0, 0, OptionArg.INT, ref tr_az_acc, "AZ accelaration [step/sec2]", "NUM"},
+		{"tr-el-acc", 0, 0, OptionArg.INT, ref tr_el_acc, "EL accelaration [step/sec2]", "NUM"},
+		{"tr-az-msp", 0, 0, OptionArg.INT, ref tr_az_msp, "AZ maximum speed [step/sec]", "NUM"},
+		{"tr-el-msp", 0, 0, OptionArg.INT, ref tr_el_msp, "EL maximum speed [step/sec]", "NUM"},
+		{"sysid", 's', 0, OptionArg.INT, ref target_sysid, "Track only this MAV system id", "ID"},
+		{"select", 0, 0, OptionArg.STRING, ref _select_policy, "Target selection: sticky (default), nearest, freshest", "POLICY"},
+		{"select-margin", 0, 0, OptionArg.INT, ref _select_margin_ms, "Freshest: other vehicle data should be newer by this to become target", "MS"},
+		{"select-dwell", 0, 0, OptionArg.INT, ref _select_dwell_ms, "Minimum time between automatic target switches", "MS"},
 		{"pub-nav", 0, 0, OptionArg.NONE, ref publish_nav_data, "Publish navigation calculation data", null},
 
 		{null}
 	};
 
-	/**
-	 * Checks receive time of mav topic
-	 */
-	private inline static bool is_mav_timedout(int64 rtime) {
-		var ct = get_monotonic_time();
-		return (ct - rtime) > mav_timeout_us;
-	}
-
 	/**
 	 * Returns last tracker position.
 	 */
@@ -63,29 +117,23 @@ class TrakD : Object {
 	}
 
 	/**
-	 * Returns last received MAV position, if not timedout
+	 * Calculates goal
 	 */
-	private static xat_msgs.lla_point_t? get_mav_position() {
-		var fix_valid = !is_mav_timedout(mav_fix_rtime);
-		var gp_valid = !is_mav_timedout(mav_global_position_rtime);
+	private static void update_goal() {
+		var now = get_monotonic_time();
+		last_solve_time = now;
 
-		xat_msgs.lla_point_t? p = null;
+		// next solve not later than 1/min-rate from this one
+		fallback_src.arm(now + max_solve_interval_us);
 
-		if (gp_valid) {
-			p = mav_global_position.p;
-		} else if (fix_valid) {
-			p = mav_fix.p;
-		}
+		var home_p = get_tracker_position();
 
-		return p;
-	}
+		// ENU frame recalculated only on home change
+		home_frame.set_origin(home_p.latitude, home_p.longitude, home_p.altitude);
 
-	/**
-	 * Calculates goal
-	 */
-	private static bool timer_update_goal() {
-		var home_p = get_tracker_position();
-		var mav_p = get_mav_position();
+		vehicles.purge(now, mav_timeout_us);
+		var mav = vehicles.select(now, mav_timeout_us, home_frame);
+		var mav_p = (mav != null)? mav.get_position(now, mav_timeout_us) : null;
 
 		// int data
 		var distance = 0.0;
@@ -97,18 +145,49 @@ class TrakD : Object {
 		var azimuth_angle = 0.0;
 
 		// valid?
+		xat_msgs.lla_point_t? mav_est_p = null;
 		if (mav_p != null) {
-			// XXX TODO estimate position
-			var mav_est_p = mav_p;
+			// aim where MAV will be when joints reach the goal
+			var iterations = (lead_enabled && planner.is_valid(now))? LEAD_ITERATIONS : 1;
+			int64 lead = 0;
+
+			for (int i = 0; i < iterations; i++) {
+				mav_est_p = mav.estimator.estimate(now + lead);
+				if (mav_est_p == null)
+					mav_est_p = mav_p;
+
+				double range;
+				home_frame.get_look_angles(mav_est_p.latitude, mav_est_p.longitude, mav_est_p.altitude,
+						out bearing, out elevation_angle, out distance, out range);
+
+				if (iterations > 1)
+					lead = planner.lead_time(goal_filter.unwrap_azimuth(bearing), elevation_angle);
+			}
 
-			// calculations based on APM AntennaTracker (tracking.pde)
-			distance = Geo.get_distance(home_p.latitude, home_p.longitude, mav_est_p.latitude, mav_est_p.longitude);
-			bearing = Geo.get_bearing(home_p.latitude, home_p.longitude, mav_est_p.latitude, mav_est_p.longitude);
 			alt_diff = mav_est_p.altitude - home_p.altitude;
 
-			elevation_angle = Math.atan2((double) alt_diff, distance);
+			if (goal_filter.update(bearing, elevation_angle, now, out azimuth_angle)) {
+				try {
+					var goal = new xat_msgs.joint_goal_t();
+
+					goal.header = goal_header.next_now();
+					goal.azimuth_angle = (float) azimuth_angle;
+					goal.elevation_angle = (float) elevation_angle;
+
+					// trace only first goal from new position
+					goal.origin_stamp = mav.trace_origin;
+					if (mav.trace_origin != 0) {
+						xat_msgs.LatencyTrace.record("trakd_solve", goal.header.stamp - mav.global_position_rtime);
+						xat_msgs.LatencyTrace.record("trakd_total", goal.header.stamp - mav.trace_origin);
+						mav.trace_origin = 0;
+					}
 
-			// todo pub joint goal
+					if (xat_msgs.LocalBus.publish(rot_goal_channel, goal))
+						lcm.publish(rot_goal_channel, xat_msgs.LocalBus.mirror(rot_goal_channel, goal.encode()));
+				} catch (Lcm.MessageError e) {
+					error("MessageError: %s", e.message);
+				}
+			}
 		}
 
 		if (publish_nav_data) {
@@ -121,9 +200,13 @@ class TrakD : Object {
 				ns.mav_p_valid = mav_p != null;
 				if (mav_p != null) {
 					ns.mav_p = mav_p;
-					ns.mav_est_p = mav_p;	// TODO
+					ns.mav_est_p = mav_est_p;
 				}
 
+				ns.mav_sysid = (mav != null)? (int16) mav.sysid : -1;
+				ns.mav_heading = (mav != null)? mav.estimator.heading : float.NAN;
+				ns.mav_ground_speed = (mav != null)? mav.estimator.ground_speed : float.NAN;
+
 				// int data
 				ns.distance = distance;
 				ns.bearing = bearing;
@@ -132,7 +215,7 @@ class TrakD : Object {
 				ns.elevation_deg = Geo.degrees(elevation_angle);
 
 				// result
-				ns.azimuth = bearing;
+				ns.azimuth = azimuth_angle;
 				ns.elevation = elevation_angle;
 
 				lcm.publish("xat/nav_status", ns.encode());
@@ -140,30 +223,144 @@ class TrakD : Object {
 				error("MessageError: %s", e.message);
 			}
 		}
+	}
 
+	/**
+	 * Periodic solver, in event mode works as a fallback
+	 * when no new data arrives. Deadline follows each solve,
+	 * so events do not make it skip a period.
+	 */
+	private static bool timer_update_goal() {
+		update_goal();
 		return true;
 	}
 
+	private static bool idle_update_goal() {
+		solver_src = 0;
+		update_goal();
+		return false;
+	}
+
+	/**
+	 * Schedule goal solving after new data arrival.
+	 *
+	 * Solver runs from low priority idle source, so all messages
+	 * already pending on LCM socket are handled before it (coalescing).
+	 * Rate limited by --max-rate.
+	 */
+	private static void request_update_goal() {
+		if (!event_driven || solver_src != 0)
+			return;
+
+		var delay = last_solve_time + min_solve_interval_us - get_monotonic_time();
+		if (delay <= 0)
+			solver_src = Idle.add(idle_update_goal, Priority.DEFAULT_IDLE);
+		else
+			solver_src = Timeout.add((uint) ((delay + 999) / 1000), idle_update_goal, Priority.DEFAULT_IDLE);
+	}
+
+	// -*- subscriber callbacks -*-
+
+	/**
+	 * Joint state from rotd
+	 */
+	private static void handle_rot_state(xat_msgs.joint_state_t st) {
+		planner.update_state(st, get_monotonic_time());
+	}
+
+	/**
+	 * MAV heartbeat from mavlinkd
+	 */
+	private static void handle_mav_heartbeat(xat_msgs.heartbeat_t hb) {
+		var mav = vehicles.get_vehicle(hb.sysid);
+
+		if (mav.heartbeat_rtime == 0)
+			message("Got HEARTBEAT, sysid %d", mav.sysid);
+
+		mav.heartbeat_rtime = get_monotonic_time();
+	}
+
+	/**
+	 * MAV GPS fix from mavlinkd
+	 */
+	private static void handle_mav_fix(xat_msgs.gps_fix_t fix) {
+		if (fix.fix_type >= xat_msgs.gps_fix_t.FIX_TYPE__2D_FIX) {
+			var mav = vehicles.get_vehicle(fix.sysid);
+			var now = get_monotonic_time();
+
+			if (mav.fix == null)
+				message("Got mav fix, sysid %d", mav.sysid);
+			if (mav.fix != null && mav.fix.fix_type > fix.fix_type)
+				warning("MAV fix type degrades, sysid %d", mav.sysid);
+
+			// global position preferred, use fix only as fallback
+			if ((now - mav.global_position_rtime) > mav_timeout_us) {
+				double vn = double.NAN, ve = double.NAN, vd = double.NAN;
+				if (fix.ground_speed.is_finite() && fix.track.is_finite()) {
+					var track = Geo.radians(fix.track);
+					vn = fix.ground_speed * Math.cos(track);
+					ve = fix.ground_speed * Math.sin(track);
+					vd = (fix.climb_rate.is_finite())? -fix.climb_rate : 0.0;
+				}
+
+				var stamp = (fix.sample_stamp != 0)? fix.sample_stamp : fix.header.stamp;
+				stamp = xat_msgs.ClockSync.to_local(mav_node, stamp);
+				mav.estimator.update(fix.p, stamp, now, vn, ve, vd);
+			}
+
+			mav.fix = fix;
+			mav.fix_rtime = now;
+			request_update_goal();
+		} else {
+			debug("MAV fix skipped (no fix).");
+		}
+	}
+
+	/**
+	 * MAV global position from mavlinkd
+	 */
+	private static void handle_mav_global_position(xat_msgs.global_position_t gp) {
+		var mav = vehicles.get_vehicle(gp.sysid);
+
+		if (mav.global_position == null)
+			message("Got mav global position, sysid %d", mav.sysid);
+
+		mav.global_position = gp;
+		mav.global_position_rtime = get_monotonic_time();
+
+		xat_msgs.LatencyTrace.record("mav_lcm",
+				mav.global_position_rtime - xat_msgs.ClockSync.to_local(mav_node, gp.header.stamp));
+		if (gp.origin_stamp != 0)
+			mav.trace_origin = xat_msgs.ClockSync.to_local(mav_node, gp.origin_stamp);
+
+		// sample time shows radio link delay, header stamp does not
+		var stamp = (gp.sample_stamp != 0)? gp.sample_stamp : gp.header.stamp;
+		stamp = xat_msgs.ClockSync.to_local(mav_node, stamp);
+		mav.estimator.update(gp.p, stamp, mav.global_position_rtime,
+				gp.velocity.x, gp.velocity.y, gp.velocity.z);
+		request_update_goal();
+	}
+
 	static construct {
 		loop = new MainLoop();
 		goal_header = new xat_msgs.HeaderFiller();
 		cmd_header = new xat_msgs.HeaderFiller();
 		ns_header = new xat_msgs.HeaderFiller();
 		def_home_p = new xat_msgs.lla_point_t();
+		vehicles = new VehicleTable();
+		goal_filter = new GoalFilter();
+		home_frame = new Geo.LocalFrame();
+		planner = new SlewPlanner();
 	}
 
-	private static void sighandler(int signum) {
-		// restore original handler
-		Posix.signal(signum, null);
-		loop.quit();
-	}
-
-	public static int main(string[] args) {
-		new TrakD();
-
-		// from FSO fraemwork
-		Posix.signal(Posix.SIGINT, sighandler);
-		Posix.signal(Posix.SIGTERM, sighandler);
+	/**
+	 * Parse options and start node on main loop
+	 *
+	 * @param host_loop loop of xat-host, null for own loop
+	 */
+	public static int setup(string[] args, MainLoop? host_loop = null) {
+		if (host_loop != null)
+			loop = host_loop;
 
 		try {
 			var opt_context = new OptionContext("");
@@ -174,9 +371,44 @@ class TrakD : Object {
 			opt_context.parse(ref args);
 
 			mav_timeout_us = _mav_timeout_ms * 1000;
+
+			if (rot_name != null) {
+				rot_goal_channel = @"xat/rot/$rot_name/goal";
+				rot_state_channel = @"xat/rot/$rot_name/state";
+			}
 			def_home_p.latitude = _home_lat;
 			def_home_p.longitude = _home_lon;
 			def_home_p.altitude = (float) _home_alt;
+			vehicles.est_max_age_us = _est_max_age_ms * 1000;
+
+			vehicles.pinned_sysid = target_sysid;
+			if (_select_policy != null) {
+				var policy = VehicleTable.Policy.parse(_select_policy);
+				if (policy == null)
+					throw new OptionError.BAD_VALUE(@"unknown selection policy: $_select_policy");
+
+				vehicles.policy = policy;
+			}
+			vehicles.freshest_margin_us = _select_margin_ms * 1000;
+			vehicles.min_dwell_us = _select_dwell_ms * 1000;
+
+			if (_min_rate <= 0 || _max_rate < _min_rate)
+				throw new OptionError.BAD_VALUE("rates should be: 0 < min-rate <= max-rate");
+
+			max_solve_interval_us = 1000000 / _min_rate;
+
+			if (az_steps_per_rev <= 0 || az_reduction_ratio <= 0.0
+					|| el_steps_per_rev <= 0 || el_reduction_ratio <= 0.0)
+				throw new OptionError.BAD_VALUE("steps and ratio should be positive");
+
+			goal_filter.az_limit = Geo.radians(_az_limit);
+			goal_filter.az_step = GoalFilter.step_angle(az_steps_per_rev, az_reduction_ratio);
+			goal_filter.el_step = GoalFilter.step_angle(el_steps_per_rev, el_reduction_ratio);
+
+			SlewPlanner.setup_axis(ref planner.az, tr_az_acc, tr_az_msp, goal_filter.az_step);
+			SlewPlanner.setup_axis(ref planner.el, tr_el_acc, tr_el_msp, goal_filter.el_step);
+			planner.max_lead_us = _max_lead_ms * 1000;
+			min_solve_interval_us = 1000000 / _max_rate;
 		} catch (OptionError e) {
 			stderr.printf("error: %s\n", e.message);
 			stderr.printf("Run '%s --help' to see a full list of available command line options.\n", args[0]);
@@ -204,6 +436,11 @@ class TrakD : Object {
 				return true;
 			});
 
+		// exchange clock offsets with other nodes
+		xat_msgs.ClockSync.start(lcm, "trakd");
+		if (trace)
+			xat_msgs.LatencyTrace.start(lcm, "trakd");
+
 		// subscribe to topics
 		lcm.subscribe("xat/command",
 			(rbuf, channel, ud) => {
@@ -231,6 +468,7 @@ class TrakD : Object {
 							warning("Home fix type degrades");
 
 						home_fix = fix;
+						request_update_goal();
 					} else {
 						debug("Home fix skipped (no fix).");
 					}
@@ -239,62 +477,91 @@ class TrakD : Object {
 				}
 			});
 
-		lcm.subscribe("xat/mav/heartbeat",
+		lcm.subscribe(rot_state_channel,
 			(rbuf, channel, ud) => {
+				if (xat_msgs.LocalBus.is_echo(channel, rbuf.data))
+					return;
+
 				try {
-					var hb = new xat_msgs.heartbeat_t.from_rbuf(rbuf);
+					handle_rot_state(new xat_msgs.joint_state_t.from_rbuf(rbuf));
+				} catch (Lcm.MessageError e) {
+					error("Message error: %s", e.message);
+				}
+			});
+		xat_msgs.LocalBus.subscribe(rot_state_channel, (msg) => handle_rot_state((xat_msgs.joint_state_t) msg));
 
-					if (mav_heartbeat_rtime == 0)
-						message("Got HEARTBEAT");
+		lcm.subscribe("xat/mav/heartbeat",
+			(rbuf, channel, ud) => {
+				if (xat_msgs.LocalBus.is_echo(channel, rbuf.data))
+					return;
 
-					mav_heartbeat_rtime = get_monotonic_time();
+				try {
+					handle_mav_heartbeat(new xat_msgs.heartbeat_t.from_rbuf(rbuf));
 				} catch (Lcm.MessageError e) {
 					error("Message error: %s", e.message);
 				}
 			});
+		xat_msgs.LocalBus.subscribe("xat/mav/heartbeat", (msg) => handle_mav_heartbeat((xat_msgs.heartbeat_t) msg));
 
 		lcm.subscribe("xat/mav/fix",
 			(rbuf, channel, ud) => {
-				try {
-					var fix = new xat_msgs.gps_fix_t.from_rbuf(rbuf);
-
-					if (fix.fix_type >= xat_msgs.gps_fix_t.FIX_TYPE__2D_FIX) {
-						if (mav_fix == null)
-							message("Got mav fix.");
-						if (mav_fix != null && mav_fix.fix_type > fix.fix_type)
-							warning("MAV fix type degrades");
+				if (xat_msgs.LocalBus.is_echo(channel, rbuf.data))
+					return;
 
-						mav_fix = fix;
-						mav_fix_rtime = get_monotonic_time();
-					} else {
-						debug("MAV fix skipped (no fix).");
-					}
+				try {
+					handle_mav_fix(new xat_msgs.gps_fix_t.from_rbuf(rbuf));
 				} catch (Lcm.MessageError e) {
 					error("Message error: %s", e.message);
 				}
 			});
+		xat_msgs.LocalBus.subscribe("xat/mav/fix", (msg) => handle_mav_fix((xat_msgs.gps_fix_t) msg));
 
 		lcm.subscribe("xat/mav/global_position",
 			(rbuf, channel, ud) => {
-				try {
-					var gp = new xat_msgs.global_position_t.from_rbuf(rbuf);
-
-					if (mav_global_position == null)
-						message("Got mav global position.");
+				if (xat_msgs.LocalBus.is_echo(channel, rbuf.data))
+					return;
 
-					mav_global_position = gp;
-					mav_global_position_rtime = get_monotonic_time();
+				try {
+					handle_mav_global_position(new xat_msgs.global_position_t.from_rbuf(rbuf));
 				} catch (Lcm.MessageError e) {
 					error("Message error: %s", e.message);
 				}
 			});
+		xat_msgs.LocalBus.subscribe("xat/mav/global_position", (msg) => handle_mav_global_position((xat_msgs.global_position_t) msg));
+
+		// start update task (10 Hz by default)
+		fallback_src = new DeadlineSource();
+		fallback_src.set_callback(timer_update_goal);
+		fallback_src.attach(null);
+		fallback_src.arm(get_monotonic_time() + max_solve_interval_us);
+		if (event_driven)
+			message("Event driven solver, rate: %d..%d Hz", _min_rate, _max_rate);
+
+		return 0;
+	}
+
+#if !XAT_HOST
+	private static void sighandler(int signum) {
+		// restore original handler
+		Posix.signal(signum, null);
+		loop.quit();
+	}
+
+	public static int main(string[] args) {
+		new TrakD();
+
+		// from FSO fraemwork
+		Posix.signal(Posix.SIGINT, sighandler);
+		Posix.signal(Posix.SIGTERM, sighandler);
 
-		// start update task at 10 Hz
-		Timeout.add(100, timer_update_goal);
+		var ret = setup(args);
+		if (ret != 0)
+			return ret;
 
 		message("trakd started.");
 		loop.run();
 		message("trakd quit");
 		return 0;
 	}
+#endif
 }
@@ -0,0 +1,203 @@
+/**
+ * Tracked vehicle data, one per MAV system id.
+ */
+class Vehicle : Object {
+	public int sysid { get; private set; }
+
+	// subscribed topic data
+	public xat_msgs.gps_fix_t? fix = null;
+	public int64 fix_rtime = 0;
+	public xat_msgs.global_position_t? global_position = null;
+	public int64 global_position_rtime = 0;
+	public int64 heartbeat_rtime = 0;
+
+	// latency trace origin of position not yet used by goal, local clock [us]
+	public int64 trace_origin = 0;
+
+	// position estimation
+	public MavEstimator estimator;
+
+	public Vehicle(int sysid) {
+		this.sysid = sysid;
+		estimator = new MavEstimator();
+	}
+
+	/**
+	 * Last position receive time
+	 */
+	public int64 position_rtime {
+		get { return int64.max(fix_rtime, global_position_rtime); }
+	}
+
+	/**
+	 * Returns last received position, if not timedout
+	 */
+	public xat_msgs.lla_point_t? get_position(int64 now, int64 timeout_us) {
+		if (global_position != null && (now - global_position_rtime) <= timeout_us)
+			return global_position.p;
+		else if (fix != null && (now - fix_rtime) <= timeout_us)
+			return fix.p;
+
+		return null;
+	}
+}
+
+/**
+ * Vehicle table with target selection.
+ *
+ * Lookup by sysid in hash table, so update is O(1).
+ */
+class VehicleTable : Object {
+	public enum Policy {
+		STICKY,		// keep target while it valid
+		NEAREST,	// nearest vehicle
+		FRESHEST;	// last updated vehicle
+
+		public static Policy? parse(string name) {
+			switch (name) {
+			case "sticky":
+				return STICKY;
+			case "nearest":
+				return NEAREST;
+			case "freshest":
+				return FRESHEST;
+			default:
+				return null;
+			}
+		}
+	}
+
+	/**
+	 * Pinned target system id, -1 - auto selection
+	 */
+	public int pinned_sysid = -1;
+	public Policy policy = Policy.STICKY;
+
+	/**
+	 * Other vehicle should be closer by this factor to become target
+	 */
+	public double nearest_hysteresis = 0.9;
+
+	/**
+	 * Other vehicle data should be newer by this time to become target
+	 */
+	public int64 freshest_margin_us = 500000;
+
+	/**
+	 * Minimum time between automatic target switches
+	 */
+	public int64 min_dwell_us = 2000000;
+
+	/**
+	 * Estimator setting for new vehicles
+	 */
+	public int64 est_max_age_us = 2000000;
+
+	private HashTable<int, Vehicle> vehicles;
+	private Vehicle? target = null;
+	private int64 target_time = 0;	// last switch time
+
+	public VehicleTable() {
+		vehicles = new HashTable<int, Vehicle>(direct_hash, direct_equal);
+	}
+
+	public uint size {
+		get { return vehicles.size(); }
+	}
+
+	/**
+	 * Returns vehicle, creates new if needed
+	 */
+	public Vehicle get_vehicle(int sysid) {
+		var v = vehicles.lookup(sysid);
+		if (v == null) {
+			message("New vehicle: sysid %d", sysid);
+			v = new Vehicle(sysid);
+			v.estimator.max_age_us = est_max_age_us;
+			vehicles.insert(sysid, v);
+		}
+
+		return v;
+	}
+
+	/**
+	 * Remove vehicles without any valid data
+	 */
+	public void purge(int64 now, int64 timeout_us) {
+		vehicles.foreach_remove((sysid, v) => {
+				if ((now - v.position_rtime) > timeout_us && (now - v.heartbeat_rtime) > timeout_us) {
+					message("Vehicle lost: sysid %d", sysid);
+					if (v == target)
+						target = null;
+					return true;
+				}
+				return false;
+			});
+	}
+
+	/**
+	 * Select target vehicle
+	 *
+	 * @param frame home frame used by NEAREST policy
+	 */
+	public Vehicle? select(int64 now, int64 timeout_us, Geo.LocalFrame frame) {
+		if (pinned_sysid >= 0) {
+			target = vehicles.lookup(pinned_sysid);
+			return target;
+		}
+
+		Vehicle? best = null;
+		double best_range = double.INFINITY;
+		int64 best_rtime = 0;
+
+		if (target != null && target.get_position(now, timeout_us) == null)
+			target = null;
+
+		if (policy == Policy.STICKY && target != null)
+			return target;
+
+		// valid target kept at least min_dwell_us
+		if (target != null && (now - target_time) < min_dwell_us)
+			return target;
+
+		vehicles.foreach((sysid, v) => {
+				var p = v.get_position(now, timeout_us);
+				if (p == null)
+					return;
+
+				switch (policy) {
+				case Policy.NEAREST:
+					double e, n, u;
+					frame.to_enu(p.latitude, p.longitude, p.altitude, out e, out n, out u);
+					var range = Math.sqrt(e * e + n * n + u * u);
+					if (v == target)
+						range *= nearest_hysteresis;
+					if (range < best_range) {
+						best_range = range;
+						best = v;
+					}
+					break;
+
+				case Policy.STICKY:
+				case Policy.FRESHEST:
+				default:
+					var rtime = v.position_rtime;
+					if (v == target)
+						rtime += freshest_margin_us;
+					if (best == null || rtime > best_rtime) {
+						best_rtime = rtime;
+						best = v;
+					}
+					break;
+				}
+			});
+
+		if (best != target && best != null) {
+			message("Target vehicle: sysid %d", best.sysid);
+			target_time = now;
+		}
+
+		target = best;
+		return target;
+	}
+}
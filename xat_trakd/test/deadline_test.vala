@@ -0,0 +1,92 @@
+/**
+ * Event driven solver with DeadlineSource fallback, as in trakd.
+ *
+ * Events come at random gaps, some shorter and some longer than
+ * 1/min-rate, also just before fallback deadline. Gap between solves
+ * should never exceed 1/min-rate, plus main loop wakeup jitter.
+ */
+
+const int64 MAX_INTERVAL_US = 50000;	// --min-rate 20
+const int64 JITTER_US = 5000;
+const int64 RUN_US = 2000000;
+
+void test_max_gap() {
+	var loop = new MainLoop();
+	var rnd = new Rand.with_seed(3);
+	var fallback = new DeadlineSource();
+
+	int64 last_solve = get_monotonic_time();
+	int64 max_gap = 0;
+	int solves = 0;
+	int fallbacks = 0;
+
+	// update_goal()
+	SourceFunc solve = () => {
+		var now = get_monotonic_time();
+		max_gap = int64.max(max_gap, now - last_solve);
+		last_solve = now;
+		solves++;
+
+		fallback.arm(now + MAX_INTERVAL_US);
+		return true;
+	};
+
+	fallback.set_callback(() => {
+			fallbacks++;
+			return solve();
+		});
+	fallback.attach(null);
+	fallback.arm(last_solve + MAX_INTERVAL_US);
+
+	// data arrival, 10..120 ms apart
+	var events = new DeadlineSource();
+	events.set_callback(() => {
+			solve();
+			events.arm(get_monotonic_time() + rnd.int_range(10, 121) * 1000);
+			return true;
+		});
+	events.attach(null);
+	events.arm(get_monotonic_time() + 10000);
+
+	Timeout.add((uint) (RUN_US / 1000), () => {
+			loop.quit();
+			return false;
+		});
+	loop.run();
+	events.destroy();
+	fallback.destroy();
+
+	assert_cmpint(fallbacks, CompareOperator.GT, 0);
+	assert_cmpint(solves, CompareOperator.GT, fallbacks);
+	assert_cmpint((int) max_gap, CompareOperator.LE, (int) (MAX_INTERVAL_US + JITTER_US));
+}
+
+void test_disarm() {
+	var loop = new MainLoop();
+	var fallback = new DeadlineSource();
+	bool fired = false;
+
+	fallback.set_callback(() => {
+			fired = true;
+			return true;
+		});
+	fallback.attach(null);
+	fallback.arm(get_monotonic_time() + 10000);
+	fallback.arm(-1);
+
+	Timeout.add(50, () => {
+			loop.quit();
+			return false;
+		});
+	loop.run();
+
+	assert(!fired);
+	fallback.destroy();
+}
+
+int main(string[] args) {
+	Test.init(ref args);
+	Test.add_func("/trakd/solver/max_gap", test_max_gap);
+	Test.add_func("/trakd/solver/disarm", test_disarm);
+	return Test.run();
+}
@@ -0,0 +1,99 @@
+/**
+ * Geo batch kernels against scalar functions.
+ *
+ * Tolerance as documented in geo.vala:
+ * distance 1e-9 relative, angles 1e-9 rad modulo 2 pi.
+ */
+
+const int POINTS = 10000;
+const double REL_TOL = 1e-9;
+const double ABS_TOL = 1e-6;	// [m], for near zero distances
+const double ANGLE_TOL = 1e-9;
+
+const double HOME_LAT = 55.7522;
+const double HOME_LON = 37.6156;
+
+// angle difference modulo 2 pi
+double angle_diff(double a, double b) {
+	var d = Math.fmod(Math.fabs(a - b), 2.0 * Math.PI);
+	return double.min(d, 2.0 * Math.PI - d);
+}
+
+// near home (tracking) and all over the globe (replay of other sites)
+void make_points(out double[] lat, out double[] lon) {
+	var rnd = new Rand.with_seed(5);
+
+	lat = new double[POINTS];
+	lon = new double[POINTS];
+	for (int i = 0; i < POINTS; i++) {
+		if (i % 2 == 0) {
+			lat[i] = HOME_LAT + rnd.double_range(-0.1, 0.1);
+			lon[i] = HOME_LON + rnd.double_range(-0.1, 0.1);
+		} else {
+			lat[i] = rnd.double_range(-89.0, 89.0);
+			lon[i] = rnd.double_range(-180.0, 180.0);
+		}
+	}
+}
+
+void test_distance() {
+	double[] lat, lon;
+	make_points(out lat, out lon);
+
+	var distance = new double[POINTS];
+	Geo.get_distance_batch(HOME_LAT, HOME_LON, lat, lon, distance);
+
+	for (int i = 0; i < POINTS; i++) {
+		var ref_d = Geo.get_distance(HOME_LAT, HOME_LON, lat[i], lon[i]);
+		assert_cmpfloat(Math.fabs(distance[i] - ref_d), CompareOperator.LE, ABS_TOL + ref_d * REL_TOL);
+	}
+}
+
+void test_bearing() {
+	double[] lat, lon;
+	make_points(out lat, out lon);
+
+	var bearing = new double[POINTS];
+	Geo.get_bearing_batch(HOME_LAT, HOME_LON, lat, lon, bearing);
+
+	for (int i = 0; i < POINTS; i++) {
+		var ref_b = Geo.get_bearing(HOME_LAT, HOME_LON, lat[i], lon[i]);
+		assert_cmpfloat(angle_diff(bearing[i], ref_b), CompareOperator.LE, ANGLE_TOL);
+		assert_cmpfloat(Math.fabs(bearing[i]), CompareOperator.LE, Math.PI);
+	}
+}
+
+void test_wrap_pi() {
+	var rnd = new Rand.with_seed(7);
+
+	// wrap_pi() uses fmod beyond ±6 pi, which does not wrap to ±pi
+	double[] angles = { Math.PI, -Math.PI, 0.0, 3.0 * Math.PI, -5.5 * Math.PI };
+	for (int i = 0; i < POINTS; i++)
+		angles += rnd.double_range(-6.0 * Math.PI, 6.0 * Math.PI);
+
+	var wrapped = angles.copy();
+	Geo.wrap_pi_batch(wrapped);
+
+	for (int i = 0; i < angles.length; i++) {
+		assert_cmpfloat(angle_diff(wrapped[i], Geo.wrap_pi(angles[i])), CompareOperator.LE, ANGLE_TOL);
+		assert_cmpfloat(Math.fabs(wrapped[i]), CompareOperator.LE, Math.PI);
+	}
+
+	// far angles wrapped too
+	double[] far = { 100.5 * Math.PI, -1e6 };
+	Geo.wrap_pi_batch(far);
+	assert_cmpfloat(Math.fabs(far[0] - 0.5 * Math.PI), CompareOperator.LE, ANGLE_TOL);
+	assert_cmpfloat(Math.fabs(far[1]), CompareOperator.LE, Math.PI);
+
+	double[] bad = { double.NAN, double.INFINITY };
+	Geo.wrap_pi_batch(bad);
+	assert(bad[0].is_nan() && bad[1].is_nan());
+}
+
+int main(string[] args) {
+	Test.init(ref args);
+	Test.add_func("/trakd/geo/distance_batch", test_distance);
+	Test.add_func("/trakd/geo/bearing_batch", test_bearing);
+	Test.add_func("/trakd/geo/wrap_pi_batch", test_wrap_pi);
+	return Test.run();
+}